@@ -0,0 +1,546 @@
+#pragma once
+#include "Utils.h"
+#include "Shapes.h"
+#include "RigidBody.h"
+#include "EditManager.h"
+#include "Profiler.h"
+#include "Transforms.h"
+#include "Scene.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+
+/*
+ * Global Allocation Counters
+ *
+ * Only builds defining BENCHMARK_ALLOCATIONS replace operator new/delete (every overload, so that each allocation is
+ * counted and released by the matching function); the other builds pay nothing and report the allocations as null
+ */
+static atomic<size_t> allocationCount(0);
+static atomic<size_t> allocationBytes(0);
+
+#ifdef BENCHMARK_ALLOCATIONS
+static void* countedAllocate(size_t size, size_t alignment)
+{
+	allocationCount++;
+	allocationBytes += size;
+	if (size == 0)
+		size = 1;
+	if (alignment <= alignof(max_align_t))
+		return malloc(size);
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void* pointer = NULL;
+	return posix_memalign(&pointer, alignment, size) == 0 ? pointer : NULL;
+#endif
+}
+
+static void countedRelease(void* pointer, size_t alignment)
+{
+#ifdef _WIN32
+	if (alignment > alignof(max_align_t))
+	{
+		_aligned_free(pointer);
+		return;
+	}
+#endif
+	free(pointer);
+}
+
+void* operator new(size_t size)
+{
+	void* pointer = countedAllocate(size, 0);
+	if (pointer == NULL)
+		throw bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, align_val_t alignment)
+{
+	void* pointer = countedAllocate(size, size_t(alignment));
+	if (pointer == NULL)
+		throw bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size, align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	return countedAllocate(size, 0);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+	return countedAllocate(size, 0);
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept
+{
+	return countedAllocate(size, size_t(alignment));
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept
+{
+	return countedAllocate(size, size_t(alignment));
+}
+
+void operator delete(void* pointer) noexcept
+{
+	countedRelease(pointer, 0);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	countedRelease(pointer, 0);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	countedRelease(pointer, 0);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+	countedRelease(pointer, 0);
+}
+
+void operator delete(void* pointer, const nothrow_t&) noexcept
+{
+	countedRelease(pointer, 0);
+}
+
+void operator delete[](void* pointer, const nothrow_t&) noexcept
+{
+	countedRelease(pointer, 0);
+}
+
+void operator delete(void* pointer, align_val_t alignment) noexcept
+{
+	countedRelease(pointer, size_t(alignment));
+}
+
+void operator delete[](void* pointer, align_val_t alignment) noexcept
+{
+	countedRelease(pointer, size_t(alignment));
+}
+
+void operator delete(void* pointer, size_t, align_val_t alignment) noexcept
+{
+	countedRelease(pointer, size_t(alignment));
+}
+
+void operator delete[](void* pointer, size_t, align_val_t alignment) noexcept
+{
+	countedRelease(pointer, size_t(alignment));
+}
+
+void operator delete(void* pointer, align_val_t alignment, const nothrow_t&) noexcept
+{
+	countedRelease(pointer, size_t(alignment));
+}
+
+void operator delete[](void* pointer, align_val_t alignment, const nothrow_t&) noexcept
+{
+	countedRelease(pointer, size_t(alignment));
+}
+#endif
+
+/*
+ * Rendering and Hot Path Benchmarks with JSON Report
+ */
+class Benchmark
+{
+public:
+	static const int DEFAULT_BODIES;
+	static const int DEFAULT_FRAMES;
+	static const int DEFAULT_EDITS;
+	static const int WARMUP_FRAMES;
+	static const int SAMPLES;
+	static const bool COUNTS_ALLOCATIONS;
+
+	struct Result {
+		string name;
+		string unit;
+		long long operations;
+		vector<double> samples;
+		double throughput;
+		double allocations;
+		double bytes;
+	};
+
+	Benchmark(vector<RigidBody*>* bodies, EditManager* manager, function<void(int)> renderFrame, unsigned int seed);
+	~Benchmark();
+
+	Benchmark* generateRandom(int count);
+	Benchmark* generateCluster(int count);
+	Benchmark* generateSparse(int count);
+	Benchmark* runScene(string name, int frames);
+	Benchmark* runEdits(string name, int edits);
+	Benchmark* runShapes(int iterations);
+	Benchmark* runCollisions(int count);
+	Benchmark* runMatrices(int iterations);
+	Benchmark* runUniforms(int iterations);
+	Benchmark* runAll(int bodies, int frames, int edits);
+	string toJson();
+
+	template <class F>
+	Result measure(string name, long long iterations, F operation);
+
+private:
+	vector<RigidBody*>* bodies;
+	EditManager* manager;
+	function<void(int)> renderFrame;
+	unsigned int seed;
+	vector<Result> results;
+
+	void clearBodies();
+	RigidBody* addBody(Shape* shape, Point position);
+	static Shape* randomShape();
+	static void perItem(Result* result, size_t items);
+	static double percentile(vector<double> samples, double percentile);
+};
+
+const int Benchmark::DEFAULT_BODIES = 1000;
+const int Benchmark::DEFAULT_FRAMES = 100;
+const int Benchmark::DEFAULT_EDITS = 1000;
+const int Benchmark::WARMUP_FRAMES = 5;
+const int Benchmark::SAMPLES = 30;
+#ifdef BENCHMARK_ALLOCATIONS
+const bool Benchmark::COUNTS_ALLOCATIONS = true;
+#else
+const bool Benchmark::COUNTS_ALLOCATIONS = false;
+#endif
+
+inline Benchmark::Benchmark(vector<RigidBody*>* bodies, EditManager* manager, function<void(int)> renderFrame, unsigned int seed)
+{
+	this->bodies = bodies;
+	this->manager = manager;
+	this->renderFrame = renderFrame;
+	this->seed = seed;
+}
+
+inline Benchmark::~Benchmark()
+{
+	clearBodies();
+}
+
+/*
+ * N primitives uniformly spread over the default view
+ */
+inline Benchmark* Benchmark::generateRandom(int count)
+{
+	clearBodies();
+	srand(seed);
+	for (int i = 0; i < count; i++)
+	{
+		addBody(randomShape(), { rand(-5.0, 5.0), rand(-3.0, 3.0), rand(-10.0, 0.0) })
+			->setScale({ rand(0.2, 1.0), rand(0.2, 1.0), rand(0.2, 1.0) })
+			->setAngles({ rand(0.0, 360.0), rand(0.0, 360.0), rand(0.0, 360.0) });
+	}
+	return this;
+}
+
+/*
+ * N primitives packed in front of the camera, heavily overlapping
+ */
+inline Benchmark* Benchmark::generateCluster(int count)
+{
+	clearBodies();
+	srand(seed);
+	for (int i = 0; i < count; i++)
+	{
+		addBody(randomShape(), { rand(-0.5, 0.5), rand(0.0, 1.0), rand(-0.5, 0.5) })
+			->setAngles({ rand(0.0, 360.0), rand(0.0, 360.0), rand(0.0, 360.0) });
+	}
+	return this;
+}
+
+/*
+ * N small primitives scattered over a large world, mostly far or out of view
+ */
+inline Benchmark* Benchmark::generateSparse(int count)
+{
+	clearBodies();
+	srand(seed);
+	for (int i = 0; i < count; i++)
+	{
+		addBody(randomShape(), { rand(-200.0, 200.0), rand(-20.0, 20.0), rand(-200.0, 200.0) })
+			->setScale({ 0.2, 0.2, 0.2 });
+	}
+	return this;
+}
+
+inline Benchmark* Benchmark::runScene(string name, int frames)
+{
+	for (int i = 0; i < WARMUP_FRAMES; i++)
+		renderFrame(i);
+
+	Profiler* profiler = new Profiler();
+	size_t count = allocationCount, bytes = allocationBytes;
+	for (int i = 0; i < frames; i++)
+	{
+		profiler->beginFrame();
+		renderFrame(i);
+		profiler->endFrame(true);
+	}
+
+	Result result = { name, "ms/frame", frames, {}, 0.0, double(allocationCount - count) / frames, double(allocationBytes - bytes) / frames };
+	double total = 0.0;
+	for (Profiler::Frame frame : *profiler->getFrames())
+	{
+		result.samples.push_back(frame.cpuTime);
+		total += frame.cpuTime;
+	}
+	result.throughput = total > 0.0 ? frames * 1000.0 / total : 0.0;
+	results.push_back(result);
+	delete profiler;
+	return this;
+}
+
+/*
+ * Selects bodies one after the other, edits them and checkpoints each edit, rendering in between
+ */
+inline Benchmark* Benchmark::runEdits(string name, int edits)
+{
+	if (bodies->empty())
+		return this;
+
+	int frame = 0;
+	results.push_back(measure(name, edits, [&]() {
+		manager->getSelected()->set(frame % bodies->size());
+		RigidBody* body = manager->getSelected()->getElement();
+		body->move({ 0.01, 0.0, -0.01 })->scale({ 0.001, 0.001, 0.001 })->rotate({ 1.0, 0.5, 0.25 });
+		manager->setCheckpoint();
+		renderFrame(frame++);
+	}));
+	manager->getSelected()->deselect();
+	return this;
+}
+
+inline Benchmark* Benchmark::runShapes(int iterations)
+{
+	srand(seed);
+	results.push_back(measure("shapes.plane", iterations, []() { delete Shapes::plane(); }));
+	results.push_back(measure("shapes.cube", iterations, []() { delete Shapes::cube(); }));
+	results.push_back(measure("shapes.pyramid", iterations, []() { delete Shapes::pyramid(); }));
+	results.push_back(measure("shapes.sphere", iterations, []() { delete Shapes::sphere(); }));
+	results.push_back(measure("shapes.cilinder", iterations, []() { delete Shapes::cilinder(); }));
+	results.push_back(measure("shapes.cone", iterations, []() { delete Shapes::cone(); }));
+	results.push_back(measure("shapes.torus", iterations, []() { delete Shapes::torus(); }));
+	return this;
+}
+
+inline Benchmark* Benchmark::runCollisions(int count)
+{
+	generateCluster(count);
+	size_t n = bodies->size(), pair = 0;
+	int collisions = 0;
+	results.push_back(measure("rigidbody.isColliding", (long long)n * n, [&]() {
+		collisions += bodies->at(pair / n % n)->isColliding(bodies->at(pair % n));
+		pair++;
+	}));
+	return this;
+}
+
+inline Benchmark* Benchmark::runMatrices(int iterations)
+{
+	Model* model = Program::getModel();
+	mat4 sink(0.0);
+	results.push_back(measure("model.matrix", iterations, [&]() {
+		model->pushMatrix();
+		model->translate(1.0, 2.0, 3.0);
+		model->scale(2.0, 2.0, 2.0);
+		model->rotate(30.0, 0.0, 1.0, 0.0);
+		model->rotate(45.0, 0.0, 0.0, 1.0);
+		model->rotate(60.0, 1.0, 0.0, 0.0);
+		sink += model->getMatrix();
+		model->pullMatrix();
+	}));
+
+	TransformBatch batch;
+	srand(seed);
+	for (int i = 0; i < 10000; i++)
+		batch.add({ rand(-5.0, 5.0), rand(-5.0, 5.0), rand(-5.0, 5.0) }, { rand(0.5, 2.0), rand(0.5, 2.0), rand(0.5, 2.0) }, Rotations::fromEuler({ rand(0.0, 360.0), rand(0.0, 360.0), rand(0.0, 360.0) }));
+	results.push_back(measure("transforms.batch", std::max(1, iterations / 10000) * SAMPLES, [&]() {
+		batch.compute();
+		sink += batch.getMatrix(0);
+	}));
+	perItem(&results.back(), batch.size());
+
+	vector<quat> from, to, out(batch.size());
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		from.push_back(Rotations::fromEuler({ rand(0.0, 360.0), rand(0.0, 360.0), rand(0.0, 360.0) }));
+		to.push_back(Rotations::fromEuler({ rand(0.0, 360.0), rand(0.0, 360.0), rand(0.0, 360.0) }));
+	}
+	results.push_back(measure("rotations.slerp", std::max(1, iterations / 10000) * SAMPLES, [&]() {
+		Rotations::slerp(from.data(), to.data(), 0.5f, out.data(), out.size());
+		sink[0][0] += out[0].w;
+	}));
+	perItem(&results.back(), out.size());
+	return this;
+}
+
+inline Benchmark* Benchmark::runUniforms(int iterations)
+{
+	Shader* shader = Program::getShader();
+	Material m = World::DEFAULT_MATERIAL;
+	long long pushed = 0;
+	results.push_back(measure("shader.uniforms", iterations, [&]() {
+		shader->setUniformFloat(Shaders::SHININESS_VARIABLE, m.shininess)
+			->setUniformVec3(Shaders::AMBIENT_PRODUCT_VARIABLE, World::DEFAULT_LIGHT.ambient * m.ambient)
+			->setUniformVec3(Shaders::DIFFUSE_PRODUCT_VARIABLE, World::DEFAULT_LIGHT.diffuse * m.diffuse)
+			->setUniformVec3(Shaders::SPECULAR_PRODUCT_VARIABLE, World::DEFAULT_LIGHT.specular * m.specular);
+		Instances::push(Model::IDENTITY);
+		if (++pushed % Instances::DEFAULT_CAPACITY == 0)
+		{
+			StreamBuffer::endFrame();
+			StreamBuffer::beginFrame();
+		}
+	}));
+	return this;
+}
+
+inline Benchmark* Benchmark::runAll(int bodies, int frames, int edits)
+{
+	generateRandom(bodies)->runScene("scene.random", frames);
+	generateCluster(bodies)->runScene("scene.cluster", frames);
+	generateSparse(bodies)->runScene("scene.sparse", frames);
+	generateRandom(bodies)->runEdits("scene.edits", edits);
+	runShapes(10);
+	runCollisions(bodies);
+	runMatrices(100000);
+	runUniforms(100000);
+	clearBodies();
+	return this;
+}
+
+inline string Benchmark::toJson()
+{
+	ostringstream json;
+	json << "{\n";
+	json << "  \"renderer\": \"" << (const char*)glGetString(GL_RENDERER) << "\",\n";
+	json << "  \"seed\": " << seed << ",\n";
+	json << "  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		Result r = results.at(i);
+		double mean = 0.0;
+		for (double sample : r.samples)
+			mean += sample / r.samples.size();
+
+		json << "    { \"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "\", \"operations\": " << r.operations
+			<< ", \"mean\": " << mean << ", \"p50\": " << percentile(r.samples, 50.0) << ", \"p90\": " << percentile(r.samples, 90.0)
+			<< ", \"p99\": " << percentile(r.samples, 99.0) << ", \"min\": " << percentile(r.samples, 0.0)
+			<< ", \"throughput\": " << r.throughput;
+		if (COUNTS_ALLOCATIONS)
+			json << ", \"allocations\": " << r.allocations << ", \"allocatedBytes\": " << r.bytes;
+		else
+			json << ", \"allocations\": null, \"allocatedBytes\": null";
+		json << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	json << "  ],\n";
+
+	// vertex cache efficiency of the default shapes (finest level of the LOD chains)
+	Shape* shapes[] = { Shapes::PLANE, Shapes::CUBE, Shapes::PYRAMID, Shapes::SPHERE, Shapes::CILINDER, Shapes::CONE, Shapes::TORUS };
+	json << "  \"meshes\": [\n";
+	for (int i = 0; i < 7; i++)
+	{
+		Shape::SubMesh finest = shapes[i]->getSubMeshes()->front();
+		MeshOptimizer::Report report = shapes[i]->getOptimizationReport();
+		json << "    { \"name\": \"" << Scene::SHAPE_NAMES[i] << "\", \"vertices\": " << finest.vertexCount
+			<< ", \"indices\": " << finest.elementCount << ", \"indexBits\": " << (shapes[i]->getIndexType() == GL_UNSIGNED_SHORT ? 16 : 32)
+			<< ", \"acmrBefore\": " << report.acmrBefore
+			<< ", \"acmrAfter\": " << report.acmrAfter << " }" << (i + 1 < 7 ? ",\n" : "\n");
+	}
+	json << "  ]\n";
+	json << "}\n";
+	return json.str();
+}
+
+/*
+ * Splits the iterations in SAMPLES batches, timing each one (ns/op) and counting allocations per operation
+ */
+template <class F>
+inline Benchmark::Result Benchmark::measure(string name, long long iterations, F operation)
+{
+	long long batch = std::max(1LL, iterations / SAMPLES);
+	Result result = { name, "ns/op", batch * SAMPLES, {}, 0.0, 0.0, 0.0 };
+
+	size_t count = allocationCount, bytes = allocationBytes;
+	double total = 0.0;
+	for (int s = 0; s < SAMPLES; s++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (long long i = 0; i < batch; i++)
+			operation();
+		glFinish();
+		double elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+		result.samples.push_back(elapsed / batch);
+		total += elapsed;
+	}
+
+	result.throughput = total > 0.0 ? result.operations * 1.0e9 / total : 0.0;
+	result.allocations = double(allocationCount - count) / result.operations;
+	result.bytes = double(allocationBytes - bytes) / result.operations;
+	return result;
+}
+
+inline void Benchmark::clearBodies()
+{
+	manager->getSelected()->deselect();
+	manager->setCheckpoint();
+	for (RigidBody* body : *bodies)
+		delete body;
+	bodies->clear();
+}
+
+inline RigidBody* Benchmark::addBody(Shape* shape, Point position)
+{
+	RigidBody* body = new RigidBody(shape);
+	body->setPosition(position);
+	bodies->push_back(body);
+	return body;
+}
+
+inline Shape* Benchmark::randomShape()
+{
+	Shape* shapes[] = { Shapes::CUBE, Shapes::PYRAMID, Shapes::SPHERE, Shapes::CILINDER, Shapes::CONE, Shapes::TORUS };
+	return shapes[rand() % 6];
+}
+
+/*
+ * Turns a result measured on batches of items into one per item
+ */
+inline void Benchmark::perItem(Result* result, size_t items)
+{
+	result->operations *= items;
+	result->throughput *= items;
+	result->allocations /= items;
+	result->bytes /= items;
+	for (double& sample : result->samples)
+		sample /= items;
+}
+
+inline double Benchmark::percentile(vector<double> samples, double percentile)
+{
+	if (samples.empty())
+		return 0.0;
+
+	size_t index = std::min(samples.size() - 1, size_t(percentile / 100.0 * samples.size()));
+	nth_element(samples.begin(), samples.begin() + index, samples.end());
+	return samples[index];
+}
\ No newline at end of file
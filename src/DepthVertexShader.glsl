@@ -0,0 +1,18 @@
+#version 420 core
+
+layout(location = 0) in vec3 vertexPosition;
+
+layout(std140, binding = 0) uniform Instance {
+	mat4 model;
+	mat4 normalMatrix;
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+
+void main()
+{
+	gl_Position = projection * view * model * vec4(vertexPosition, 1.0);		// stessa espressione del vertex shader di shading, per il test GL_EQUAL
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#pragma once
+#include "Utils.h"
+#include "Global.h"
+
+/*
+ * Offscreen Render Target whose Resolution Follows the Measured GPU Frame Time
+ *
+ * The buffers are as large as the window, and only the viewport shrinks with the scale, so that changing it never
+ * reallocates them. update smooths the GPU times and, while the average is over BUDGET or well under it, moves the
+ * scale (at most MAX_STEP per frame, never under MIN_SCALE) towards the one whose pixel count (the square of the scale)
+ * would bring it back in the middle of the band. blit upscales the rendered region, filtering linearly, to the
+ * framebuffer bound at bind time
+ */
+class DynamicResolution
+{
+public:
+	static bool ENABLED;
+	static double BUDGET;
+	static const float MIN_SCALE;
+	static const float MAX_STEP;
+	static const double SMOOTHING;
+	static const double HEADROOM;
+
+	DynamicResolution(int width, int height);
+	~DynamicResolution();
+
+	DynamicResolution* resize(int width, int height);
+	DynamicResolution* update(double gpuTime);
+	DynamicResolution* bind();
+	DynamicResolution* blit();
+	float getScale();
+	int getWidth();
+	int getHeight();
+
+private:
+	int windowWidth, windowHeight;
+	float scale;
+	double average;
+	GLint output;
+	GLuint framebuffer, colorBuffer, depthBuffer;
+
+	void createFramebuffer();
+	void deleteFramebuffer();
+};
+
+bool DynamicResolution::ENABLED = false;
+double DynamicResolution::BUDGET = 1000.0 / Animation::FPS;
+const float DynamicResolution::MIN_SCALE = 0.5f;
+const float DynamicResolution::MAX_STEP = 0.05f;
+const double DynamicResolution::SMOOTHING = 0.2;
+const double DynamicResolution::HEADROOM = 0.2;
+
+inline DynamicResolution::DynamicResolution(int width, int height)
+{
+	windowWidth = std::max(width, 1);
+	windowHeight = std::max(height, 1);
+	scale = 1.0f;
+	average = -1.0;
+	output = 0;
+	createFramebuffer();
+}
+
+inline DynamicResolution::~DynamicResolution()
+{
+	deleteFramebuffer();
+}
+
+/*
+ * New window size; the scale is kept
+ */
+inline DynamicResolution* DynamicResolution::resize(int width, int height)
+{
+	width = std::max(width, 1);
+	height = std::max(height, 1);
+	if (width == windowWidth && height == windowHeight)
+		return this;
+	windowWidth = width;
+	windowHeight = height;
+	deleteFramebuffer();
+	createFramebuffer();
+	return this;
+}
+
+/*
+ * Feeds the GPU time (ms) of a finished frame; negative times (not read back yet) are ignored
+ */
+inline DynamicResolution* DynamicResolution::update(double gpuTime)
+{
+	if (gpuTime < 0.0)
+		return this;
+	average = average < 0.0 ? gpuTime : average + SMOOTHING * (gpuTime - average);
+	if (average <= 0.0 || (average <= BUDGET && average >= BUDGET * (1.0 - HEADROOM)))
+		return this;
+
+	float target = glm::clamp(float(scale * sqrt(BUDGET * (1.0 - HEADROOM / 2.0) / average)), MIN_SCALE, 1.0f);
+	scale += glm::clamp(target - scale, -MAX_STEP, MAX_STEP);
+	return this;
+}
+
+/*
+ * Renders into the scaled region of the offscreen buffers from now on
+ */
+inline DynamicResolution* DynamicResolution::bind()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, getWidth(), getHeight());
+	return this;
+}
+
+/*
+ * Upscales the rendered region to the whole framebuffer bound before bind, which is bound again
+ */
+inline DynamicResolution* DynamicResolution::blit()
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output);
+	glBlitFramebuffer(0, 0, getWidth(), getHeight(), 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+	glViewport(0, 0, windowWidth, windowHeight);
+	return this;
+}
+
+inline float DynamicResolution::getScale()
+{
+	return scale;
+}
+
+inline int DynamicResolution::getWidth()
+{
+	return std::max(1, int(windowWidth * scale + 0.5f));
+}
+
+inline int DynamicResolution::getHeight()
+{
+	return std::max(1, int(windowHeight * scale + 0.5f));
+}
+
+inline void DynamicResolution::createFramebuffer()
+{
+	GLint previous = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, windowWidth, windowHeight);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, windowWidth, windowHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		throw "incomplete dynamic resolution framebuffer";
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+inline void DynamicResolution::deleteFramebuffer()
+{
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+}
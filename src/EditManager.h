@@ -1,278 +1,376 @@
-#pragma once
-#include "Utils.h"
-#include "RigidBody.h"
-
-enum Edit { NOEDIT = '-', CAMERA_MOVING = 'M', CAMERA_FIXING = 'F', TRASLATION = 'T', SCALING = 'S', ROTATION = 'R' };
-enum Axe { NOAXE = '-', X = 'X', Y = 'Y', Z = 'Z', ALL = 'A' };
-
-class EditManager
-{
-public:
-	static Vector getValueOnAxe(double value, Axe axe);
-
-	EditManager(vector<RigidBody*> *bodies);
-	~EditManager();
-
-	Edit getEdit();
-	Axe getAxe();
-	Optional<vec2>* getMousePosition();
-	Selector<RigidBody*>* getSelected();
-	EditManager* deleteSelected();
-	EditManager* setEdit(Edit edit, vec2 position = { 0.0, 0.0 });
-	EditManager* setEdit(char edit, vec2 position = { 0.0, 0.0 });
-	EditManager* setAxe(Axe axe);
-	EditManager* setAxe(char axe);
-
-	EditManager* setCheckpoint();
-	EditManager* backup();
-
-	bool isEdit(Edit edit);
-	bool isEdit(char edit);
-	bool isAxe(Axe axe);
-	bool isAxe(char axe);
-	bool isNotEdit(Edit edit);
-	bool isNotEdit(char edit);
-	bool isNotAxe(Axe axe);
-	bool isNotAxe(char axe);
-
-	bool onObjectEditing();
-	bool onAxeEnabled();
-	Vector getValueOnAxe(double value);
-
-private:
-	Edit edit;
-	Axe axe;
-	Optional<vec2> mousePosition;
-	Optional<RigidBody*> backupBody;
-	Selector<RigidBody*>* selectedBody;
-
-	void log();
-	string editString();
-	string axeString();
-};
-
-inline Vector EditManager::getValueOnAxe(double value, Axe axe)
-{
-	switch (axe)
-	{
-	case X:
-		return Vector(value, 0.0, 0.0);
-	case Y:
-		return Vector(0.0, value, 0.0);
-	case Z:
-		return Vector(0.0, 0.0, value);
-	case ALL:
-		return Vector(value, value, value);
-	default:
-		return Vector(0.0, 0.0, 0.0);
-	}
-}
-
-inline EditManager::EditManager(vector<RigidBody*>* bodies)
-{
-	mousePosition = Optional<vec2>();
-	backupBody = Optional<RigidBody*>();
-	selectedBody = new Selector<RigidBody*>(bodies);
-	setAxe(NOAXE);
-	setEdit(NOEDIT);
-}
-
-inline EditManager::~EditManager()
-{
-	delete selectedBody;
-}
-
-inline Edit EditManager::getEdit()
-{
-	return edit;
-}
-
-inline Axe EditManager::getAxe()
-{
-	return axe;
-}
-
-inline Optional<vec2>* EditManager::getMousePosition()
-{
-	return &mousePosition;
-}
-
-inline Selector<RigidBody*>* EditManager::getSelected()
-{
-	return selectedBody;
-}
-
-inline EditManager* EditManager::deleteSelected()
-{
-	return this;
-}
-
-inline EditManager* EditManager::setEdit(Edit edit, vec2 position)
-{
-	if ((edit == TRASLATION || edit == SCALING || edit == ROTATION) && selectedBody->isNotPresent())
-		return this;
-
-	if (edit == NOEDIT || edit == CAMERA_MOVING)
-		this->mousePosition.empty();
-
-	this->edit = edit;
-	this->mousePosition = position;
-	log();
-	return this;
-}
-
-inline EditManager* EditManager::setEdit(char edit, vec2 position)
-{
-	return setEdit(Edit(toupper(edit)), position);
-}
-
-inline EditManager* EditManager::setAxe(Axe axe)
-{
-	switch (axe) 
-	{
-	case ALL:
-		this->axe = ALL;
-		break;
-	case NOAXE:
-		this->axe = NOAXE;
-		if (isEdit(CAMERA_MOVING))
-			setEdit(NOEDIT);
-		break;
-	case X:
-	case Y:
-	case Z:
-		this->axe = (isAxe(ALL)) ? ALL : axe;
-		if (isEdit(NOEDIT))
-			setEdit(CAMERA_MOVING);
-		break;
-	default:
-		break;
-	}
-
-	log();
-	return this;
-}
-
-inline EditManager * EditManager::setAxe(char axe)
-{
-	return setAxe(Axe(toupper(axe)));
-}
-
-inline EditManager* EditManager::setCheckpoint()
-{
-	if (backupBody.isPresent())
-		delete backupBody.get();
-	selectedBody->isPresent() ? backupBody.set(new RigidBody(*selectedBody->getElement())) : backupBody.empty();
-	return this;
-}
-
-inline EditManager* EditManager::backup()
-{
-	if (selectedBody->isPresent() && backupBody.isPresent())
-	{
-		selectedBody->getElement()->setPosition(backupBody.get()->getPosition());
-		selectedBody->getElement()->setScale(backupBody.get()->getScale());
-		selectedBody->getElement()->setAngles(backupBody.get()->getAngles());
-	}
-	return this;
-}
-
-inline bool EditManager::isEdit(Edit edit)
-{
-	return this->edit == edit;
-}
-
-inline bool EditManager::isEdit(char edit)
-{
-	return this->edit == Edit(toupper(edit));
-}
-
-inline bool EditManager::isAxe(Axe axe)
-{
-	return this->axe == axe;
-}
-
-inline bool EditManager::isAxe(char axe)
-{
-	return this->axe == Axe(toupper(axe));
-}
-
-inline bool EditManager::isNotEdit(Edit edit)
-{
-	return !isEdit(edit);
-}
-
-inline bool EditManager::isNotEdit(char edit)
-{
-	return !isEdit(edit);
-}
-
-inline bool EditManager::isNotAxe(Axe axe)
-{
-	return !isAxe(axe);
-}
-
-inline bool EditManager::isNotAxe(char axe)
-{
-	return !isAxe(axe);
-}
-
-inline bool EditManager::onObjectEditing()
-{
-	return isEdit(TRASLATION) || isEdit(SCALING) || isEdit(ROTATION);
-}
-
-inline bool EditManager::onAxeEnabled()
-{
-	return isAxe(X) || isAxe(Y) || isAxe(Z);
-}
-
-inline Vector EditManager::getValueOnAxe(double value)
-{
-	return EditManager::getValueOnAxe(value, axe);
-}
-
-inline void EditManager::log()
-{
-	system("cls");
-	cout << "Edit Mode: " << editString() << endl;
-	cout << "Enabled Axe: " << axeString() << endl;
-}
-
-inline string EditManager::editString()
-{
-	switch (edit) {
-	case NOEDIT:
-		return "None";
-	case CAMERA_MOVING:
-		return "Moving Camera";
-	case CAMERA_FIXING:
-		return "Fixing Camera";
-	case TRASLATION:
-		return "Traslation";
-	case SCALING:
-		return "Scaling";
-	case ROTATION:
-		return "Rotation";
-	default:
-		return "Unknown";
-	}
-}
-
-inline string EditManager::axeString()
-{
-	switch (axe) {
-	case NOAXE:
-		return "None";
-	case X:
-		return "X";
-	case Y:
-		return "Y";
-	case Z:
-		return "Z";
-	case ALL:
-		return "All";
-	default:
-		return "Unknown";
-	}
-}
+#pragma once
+#include "Utils.h"
+#include "RigidBody.h"
+#include "Normals.h"
+#include <map>
+#include <tuple>
+
+enum Edit { NOEDIT = '-', CAMERA_MOVING = 'M', CAMERA_FIXING = 'F', TRASLATION = 'T', SCALING = 'S', ROTATION = 'R', DEFORMING = 'D' };
+enum Axe { NOAXE = '-', X = 'X', Y = 'Y', Z = 'Z', ALL = 'A' };
+
+class EditManager
+{
+public:
+	static Vector getValueOnAxe(double value, Axe axe);
+
+	EditManager(vector<RigidBody*> *bodies);
+	~EditManager();
+
+	Edit getEdit();
+	Axe getAxe();
+	Optional<vec2>* getMousePosition();
+	Selector<RigidBody*>* getSelected();
+	EditManager* deleteSelected();
+	EditManager* setEdit(Edit edit, vec2 position = { 0.0, 0.0 });
+	EditManager* setEdit(char edit, vec2 position = { 0.0, 0.0 });
+	EditManager* setAxe(Axe axe);
+	EditManager* setAxe(char axe);
+	EditManager* deformSelected(Vector delta);
+	EditManager* paintSelected(Optional<Color> c = Optional<Color>());
+
+	EditManager* setCheckpoint();
+	EditManager* backup();
+
+	bool isEdit(Edit edit);
+	bool isEdit(char edit);
+	bool isAxe(Axe axe);
+	bool isAxe(char axe);
+	bool isNotEdit(Edit edit);
+	bool isNotEdit(char edit);
+	bool isNotAxe(Axe axe);
+	bool isNotAxe(char axe);
+
+	bool onObjectEditing();
+	bool onAxeEnabled();
+	Vector getValueOnAxe(double value);
+
+private:
+	Edit edit;
+	Axe axe;
+	Optional<vec2> mousePosition;
+	Optional<RigidBody*> backupBody;
+	Selector<RigidBody*>* selectedBody;
+	Shape* deformed;
+	vector<Point> directions;
+
+	static vector<Point> getDirections(Shape* shape);
+	void log();
+	string editString();
+	string axeString();
+};
+
+inline Vector EditManager::getValueOnAxe(double value, Axe axe)
+{
+	switch (axe)
+	{
+	case X:
+		return Vector(value, 0.0, 0.0);
+	case Y:
+		return Vector(0.0, value, 0.0);
+	case Z:
+		return Vector(0.0, 0.0, value);
+	case ALL:
+		return Vector(value, value, value);
+	default:
+		return Vector(0.0, 0.0, 0.0);
+	}
+}
+
+inline EditManager::EditManager(vector<RigidBody*>* bodies)
+{
+	mousePosition = Optional<vec2>();
+	backupBody = Optional<RigidBody*>();
+	selectedBody = new Selector<RigidBody*>(bodies);
+	edit = NOEDIT;
+	deformed = NULL;
+	setAxe(NOAXE);
+	setEdit(NOEDIT);
+}
+
+inline EditManager::~EditManager()
+{
+	delete selectedBody;
+}
+
+inline Edit EditManager::getEdit()
+{
+	return edit;
+}
+
+inline Axe EditManager::getAxe()
+{
+	return axe;
+}
+
+inline Optional<vec2>* EditManager::getMousePosition()
+{
+	return &mousePosition;
+}
+
+inline Selector<RigidBody*>* EditManager::getSelected()
+{
+	return selectedBody;
+}
+
+inline EditManager* EditManager::deleteSelected()
+{
+	return this;
+}
+
+/*
+ * While DEFORMING the shape of the selected body is dynamic, its vertices streamed at every edit, and it goes back to
+ * static buffers once the edit ends
+ */
+inline EditManager* EditManager::setEdit(Edit edit, vec2 position)
+{
+	if ((edit == TRASLATION || edit == SCALING || edit == ROTATION || edit == DEFORMING) && selectedBody->isNotPresent())
+		return this;
+	if (edit == DEFORMING && (selectedBody->getElement()->getShape() == NULL || !selectedBody->getElement()->getShape()->hasMirror()))
+		return this;
+
+	if (this->edit == DEFORMING && edit != DEFORMING)
+	{
+		deformed->setDynamic(false);
+		deformed = NULL;
+		directions.clear();
+	}
+	if (edit == DEFORMING && this->edit != DEFORMING)
+	{
+		deformed = selectedBody->getElement()->getShape();
+		deformed->setDynamic(true);
+		directions = getDirections(deformed);
+	}
+
+	if (edit == NOEDIT || edit == CAMERA_MOVING)
+		this->mousePosition.empty();
+
+	this->edit = edit;
+	this->mousePosition = position;
+	log();
+	return this;
+}
+
+inline EditManager* EditManager::setEdit(char edit, vec2 position)
+{
+	return setEdit(Edit(toupper(edit)), position);
+}
+
+inline EditManager* EditManager::setAxe(Axe axe)
+{
+	switch (axe) 
+	{
+	case ALL:
+		this->axe = ALL;
+		break;
+	case NOAXE:
+		this->axe = NOAXE;
+		if (isEdit(CAMERA_MOVING))
+			setEdit(NOEDIT);
+		break;
+	case X:
+	case Y:
+	case Z:
+		this->axe = (isAxe(ALL)) ? ALL : axe;
+		if (isEdit(NOEDIT))
+			setEdit(CAMERA_MOVING);
+		break;
+	default:
+		break;
+	}
+
+	log();
+	return this;
+}
+
+inline EditManager * EditManager::setAxe(char axe)
+{
+	return setAxe(Axe(toupper(axe)));
+}
+
+/*
+ * Moves every vertex of the shape being deformed by delta, scaled on each axis by its direction; the shape is edited
+ * in place, so the bodies sharing it change too
+ */
+inline EditManager* EditManager::deformSelected(Vector delta)
+{
+	if (isNotEdit(DEFORMING))
+		return this;
+
+	vector<Point>* vertices = deformed->getVertices();
+	for (size_t v = 0; v < vertices->size(); v++)
+	{
+		vertices->at(v).x += directions[v].x * delta.x;
+		vertices->at(v).y += directions[v].y * delta.y;
+		vertices->at(v).z += directions[v].z * delta.z;
+	}
+	deformed->updateVertices(0, vertices->size());
+	return this;
+}
+
+/*
+ * Gives the vertices of the selected shape c, or a random color each when c is empty
+ */
+inline EditManager* EditManager::paintSelected(Optional<Color> c)
+{
+	if (selectedBody->isNotPresent())
+		return this;
+	Shape* shape = selectedBody->getElement()->getShape();
+	if (shape == NULL || !shape->hasMirror())
+		return this;
+
+	for (Color& color : *shape->getColors())
+		color = c.orElse({ rand(0.0, 1.0), rand(0.0, 1.0), rand(0.0, 1.0), 1.0 });
+	shape->updateColors(0, shape->getColors()->size());
+	return this;
+}
+
+inline EditManager* EditManager::setCheckpoint()
+{
+	if (backupBody.isPresent())
+		delete backupBody.get();
+	selectedBody->isPresent() ? backupBody.set(new RigidBody(*selectedBody->getElement())) : backupBody.empty();
+	return this;
+}
+
+inline EditManager* EditManager::backup()
+{
+	if (selectedBody->isPresent() && backupBody.isPresent())
+	{
+		selectedBody->getElement()->setPosition(backupBody.get()->getPosition());
+		selectedBody->getElement()->setScale(backupBody.get()->getScale());
+		selectedBody->getElement()->setOrientation(backupBody.get()->getOrientation());
+	}
+	return this;
+}
+
+inline bool EditManager::isEdit(Edit edit)
+{
+	return this->edit == edit;
+}
+
+inline bool EditManager::isEdit(char edit)
+{
+	return this->edit == Edit(toupper(edit));
+}
+
+inline bool EditManager::isAxe(Axe axe)
+{
+	return this->axe == axe;
+}
+
+inline bool EditManager::isAxe(char axe)
+{
+	return this->axe == Axe(toupper(axe));
+}
+
+inline bool EditManager::isNotEdit(Edit edit)
+{
+	return !isEdit(edit);
+}
+
+inline bool EditManager::isNotEdit(char edit)
+{
+	return !isEdit(edit);
+}
+
+inline bool EditManager::isNotAxe(Axe axe)
+{
+	return !isAxe(axe);
+}
+
+inline bool EditManager::isNotAxe(char axe)
+{
+	return !isAxe(axe);
+}
+
+inline bool EditManager::onObjectEditing()
+{
+	return isEdit(TRASLATION) || isEdit(SCALING) || isEdit(ROTATION) || isEdit(DEFORMING);
+}
+
+inline bool EditManager::onAxeEnabled()
+{
+	return isAxe(X) || isAxe(Y) || isAxe(Z);
+}
+
+inline Vector EditManager::getValueOnAxe(double value)
+{
+	return EditManager::getValueOnAxe(value, axe);
+}
+
+/*
+ * Smooth normals of the shape with the vertices at the same position welded, so that the faces of a flat shape (whose
+ * vertices are split by orientation) stay joined when moved along them
+ */
+inline vector<Point> EditManager::getDirections(Shape* shape)
+{
+	vector<Point>* vertices = shape->getVertices();
+	map<tuple<double, double, double>, GLuint> positions;
+	vector<Point> welded;
+	vector<GLuint> weld(vertices->size());
+	for (size_t v = 0; v < vertices->size(); v++)
+	{
+		Point p = vertices->at(v);
+		weld[v] = positions.insert({ make_tuple(p.x, p.y, p.z), (GLuint)welded.size() }).first->second;
+		if (weld[v] == welded.size())
+			welded.push_back(p);
+	}
+
+	vector<Index> triangles;
+	triangles.reserve(shape->getIndices()->size());
+	for (Index t : *shape->getIndices())
+		triangles.push_back({ weld[t.i], weld[t.j], weld[t.k] });
+	vector<Point> normals = Normals::smooth(welded, triangles);
+
+	vector<Point> directions(vertices->size());
+	for (size_t v = 0; v < vertices->size(); v++)
+		directions[v] = normals[weld[v]];
+	return directions;
+}
+
+inline void EditManager::log()
+{
+	system("cls");
+	cout << "Edit Mode: " << editString() << endl;
+	cout << "Enabled Axe: " << axeString() << endl;
+}
+
+inline string EditManager::editString()
+{
+	switch (edit) {
+	case NOEDIT:
+		return "None";
+	case CAMERA_MOVING:
+		return "Moving Camera";
+	case CAMERA_FIXING:
+		return "Fixing Camera";
+	case TRASLATION:
+		return "Traslation";
+	case SCALING:
+		return "Scaling";
+	case ROTATION:
+		return "Rotation";
+	case DEFORMING:
+		return "Deforming";
+	default:
+		return "Unknown";
+	}
+}
+
+inline string EditManager::axeString()
+{
+	switch (axe) {
+	case NOAXE:
+		return "None";
+	case X:
+		return "X";
+	case Y:
+		return "Y";
+	case Z:
+		return "Z";
+	case ALL:
+		return "All";
+	default:
+		return "Unknown";
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "Utils.h"
+#include <map>
+#include <chrono>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+/*
+ * Watcher Reporting which of a Set of Files Changed since the Last Poll
+ *
+ * On Linux the directories of the files are watched with inotify (editors often save by writing a new file and renaming
+ * it, so whole directories are watched and events filtered by name); elsewhere the modification times are compared,
+ * at most every POLL_INTERVAL milliseconds. poll never blocks
+ */
+class FileWatcher
+{
+public:
+	static const int POLL_INTERVAL;
+
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher* add(string file);
+	vector<string> poll();
+
+private:
+	map<string, time_t> files;
+	chrono::steady_clock::time_point lastPoll;
+#ifdef __linux__
+	int descriptor;
+	map<int, string> directories;
+#endif
+
+	static time_t getModificationTime(string file);
+	static string getDirectory(string file);
+};
+
+const int FileWatcher::POLL_INTERVAL = 500;
+
+inline FileWatcher::FileWatcher()
+{
+	lastPoll = chrono::steady_clock::now();
+#ifdef __linux__
+	descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+inline FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (descriptor >= 0)
+		close(descriptor);
+#endif
+}
+
+inline FileWatcher* FileWatcher::add(string file)
+{
+	files[file] = getModificationTime(file);
+#ifdef __linux__
+	string directory = getDirectory(file);
+	if (descriptor >= 0)
+	{
+		int watch = inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (watch >= 0)
+			directories[watch] = directory;
+	}
+#endif
+	return this;
+}
+
+/*
+ * Each changed file is reported once, however many events it got
+ */
+inline vector<string> FileWatcher::poll()
+{
+	vector<string> changed;
+#ifdef __linux__
+	if (descriptor >= 0)
+	{
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(descriptor, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* event = buffer; event < buffer + length; event += sizeof(inotify_event) + ((inotify_event*)event)->len)
+			{
+				inotify_event* e = (inotify_event*)event;
+				if (e->len == 0 || directories.find(e->wd) == directories.end())
+					continue;
+				string directory = directories[e->wd];
+				string file = directory == "." ? string(e->name) : directory + "/" + e->name;
+				if (files.find(file) != files.end() && find(changed.begin(), changed.end(), file) == changed.end())
+					changed.push_back(file);
+			}
+		}
+		return changed;
+	}
+#endif
+
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if (now - lastPoll < chrono::milliseconds(POLL_INTERVAL))
+		return changed;
+	lastPoll = now;
+	for (pair<const string, time_t>& file : files)
+	{
+		time_t time = getModificationTime(file.first);
+		if (time != file.second)
+		{
+			file.second = time;
+			changed.push_back(file.first);
+		}
+	}
+	return changed;
+}
+
+/*
+ * Zero when the file cannot be read, so that it is reported again once it comes back
+ */
+inline time_t FileWatcher::getModificationTime(string file)
+{
+	struct stat info;
+	return stat(file.c_str(), &info) == 0 ? info.st_mtime : 0;
+}
+
+inline string FileWatcher::getDirectory(string file)
+{
+	size_t slash = file.find_last_of("/\\");
+	return slash == string::npos ? "." : file.substr(0, slash);
+}
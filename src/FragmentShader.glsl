@@ -1,10 +1,93 @@
-#version 420 core
-
-in vec4 Color;
-
-out vec4 interpolatedColor;
-
-void main()
-{
-	interpolatedColor = Color;
+#version 420 core
+
+#ifndef LIGHTS
+#define LIGHTS 1
+#endif
+
+#ifdef CLUSTERED
+#extension GL_ARB_shader_storage_buffer_object : require
+
+struct ClusterLight {
+	vec4 positionRadius;
+	vec4 colorCutoff;
+	vec4 direction;
+};
+
+layout(std430, binding = 2) readonly buffer ClusterLights {
+	ClusterLight clusterLights[];
+};
+
+layout(std430, binding = 3) readonly buffer Clusters {
+	uvec2 clusters[];
+};
+
+layout(std430, binding = 4) readonly buffer ClusterIndices {
+	uint clusterIndices[];
+};
+
+uniform mat4 view;
+uniform vec4 clusterScale;
+uniform vec4 clusterGrid;
+#endif
+
+#ifdef PER_PIXEL
+in vec3 Position;
+in vec3 Normal;
+
+uniform vec3 eyePosition;
+uniform float shininess;
+uniform vec3 lightPosition[LIGHTS];
+uniform float lightCount;
+uniform vec3 ambientProduct;
+uniform vec3 diffuseProduct;
+uniform vec3 specularProduct;
+#endif
+
+in vec4 Color;
+
+out vec4 interpolatedColor;
+
+void main()
+{
+#ifdef PER_PIXEL
+	vec3 N = normalize(Normal);
+	vec3 V = normalize(eyePosition - Position);
+	vec3 light = ambientProduct;
+#ifdef CLUSTERED
+	// only the eye light, the scene lights are added from the cluster below
+	int uniformLights = min(int(lightCount), 1);
+#else
+	int uniformLights = min(int(lightCount), LIGHTS);
+#endif
+	for (int i = 0; i < uniformLights; i++)
+	{
+		vec3 L = normalize(lightPosition[i] - Position);
+		vec3 R = -normalize(reflect(L, N));
+		light += diffuseProduct * max(dot(L, N), 0.0);
+		light += specularProduct * pow(max(dot(R, V), 0.0), shininess);
+	}
+#ifdef CLUSTERED
+	float depth = -(view * vec4(Position, 1.0)).z;
+	ivec3 cell = ivec3(gl_FragCoord.xy * clusterScale.xy, log(max(depth, 1e-4)) * clusterScale.z - clusterScale.w);
+	cell = clamp(cell, ivec3(0), ivec3(clusterGrid.xyz) - 1);
+	uvec2 cluster = clusters[cell.x + int(clusterGrid.x) * (cell.y + int(clusterGrid.y) * cell.z)];
+	for (uint i = cluster.x; i < cluster.x + cluster.y; i++)
+	{
+		ClusterLight source = clusterLights[clusterIndices[i]];
+		vec3 toLight = source.positionRadius.xyz - Position;
+		float d = length(toLight);
+		vec3 L = toLight / max(d, 1e-4);
+		float falloff = clamp(1.0 - pow(d / source.positionRadius.w, 2.0), 0.0, 1.0);
+		float attenuation = falloff * falloff;
+		if (source.colorCutoff.w > -1.0)
+			attenuation *= smoothstep(source.colorCutoff.w, mix(source.colorCutoff.w, 1.0, 0.1), dot(-L, source.direction.xyz));
+		vec3 R = -normalize(reflect(L, N));
+		vec3 lit = diffuseProduct * max(dot(L, N), 0.0) + specularProduct * pow(max(dot(R, V), 0.0), shininess);
+		light += lit * source.colorCutoff.rgb * attenuation;
+	}
+#endif
+	interpolatedColor = vec4(Color.rgb * light, Color.a);
+#else
+	interpolatedColor = Color;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include "Utils.h"
+
+/*
+ * Clipping Planes of a View-Projection Matrix, to Cull Bounding Spheres
+ */
+class Frustum
+{
+public:
+	Frustum(const mat4& viewProjection);
+	bool intersects(Point center, double radius);
+
+private:
+	vec4 planes[6];
+};
+
+/*
+ * Each plane is the last row of the matrix plus or minus one of the others, normalized so that distances are in world units
+ */
+inline Frustum::Frustum(const mat4& viewProjection)
+{
+	vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	for (int i = 0; i < 3; i++)
+	{
+		planes[2 * i] = rows[3] + rows[i];
+		planes[2 * i + 1] = rows[3] - rows[i];
+	}
+	for (vec4& plane : planes)
+		plane = plane / length(vec3(plane.x, plane.y, plane.z));
+}
+
+inline bool Frustum::intersects(Point center, double radius)
+{
+	for (vec4 plane : planes)
+	{
+		if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
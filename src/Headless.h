@@ -0,0 +1,147 @@
+#pragma once
+#include "Utils.h"
+#include "Image.h"
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+/*
+ * Offscreen OpenGL Context (EGL Surfaceless) Rendering into a Framebuffer Object
+ */
+class Headless
+{
+public:
+	Headless(int width, int height);
+	~Headless();
+
+	int getWidth();
+	int getHeight();
+	Headless* bind();
+	Headless* capture(Image* image);
+
+private:
+	int width, height;
+	GLuint framebuffer, colorBuffer, depthBuffer;
+#ifdef __linux__
+	EGLDisplay display;
+	EGLContext context;
+#endif
+
+	void createContext();
+	void createFramebuffer();
+};
+
+inline Headless::Headless(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	createContext();
+	createFramebuffer();
+}
+
+inline Headless::~Headless()
+{
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+#ifdef __linux__
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+#endif
+}
+
+inline int Headless::getWidth()
+{
+	return width;
+}
+
+inline int Headless::getHeight()
+{
+	return height;
+}
+
+inline Headless* Headless::bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+	return this;
+}
+
+inline Headless* Headless::capture(Image* image)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	image->readFramebuffer();
+	return this;
+}
+
+inline void Headless::createContext()
+{
+#ifdef __linux__
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+		throw "cannot initialize EGL display";
+	if (!eglBindAPI(EGL_OPENGL_API))
+		throw "EGL does not support desktop OpenGL";
+
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	EGLint configs = 0;
+	eglChooseConfig(display, configAttributes, &config, 1, &configs);
+	if (configs == 0)
+		config = EGL_NO_CONFIG_KHR;
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 2,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+		throw "cannot create an OpenGL 4.2 core context";
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		throw "cannot make the EGL context current";
+
+	glewExperimental = GL_TRUE;
+	GLenum error = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	if (error == GLEW_ERROR_NO_GLX_DISPLAY)
+		error = GLEW_OK;
+#endif
+	if (error != GLEW_OK)
+		throw "cannot initialize GLEW";
+#else
+	throw "headless rendering requires EGL";
+#endif
+}
+
+inline void Headless::createFramebuffer()
+{
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		throw "incomplete offscreen framebuffer";
+	bind();
+}
\ No newline at end of file
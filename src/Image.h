@@ -0,0 +1,179 @@
+#pragma once
+#include "Utils.h"
+#include <fstream>
+
+/*
+ * RGB Image with PPM/PNG Output
+ */
+class Image
+{
+public:
+	Image(int width, int height);
+
+	int getWidth();
+	int getHeight();
+	unsigned char* getPixels();
+	Image* readFramebuffer();
+	Image* flipVertically();
+	Image* save(string filename);
+	Image* savePPM(string filename);
+	Image* savePNG(string filename);
+
+private:
+	int width, height;
+	vector<unsigned char> pixels;
+
+	static unsigned int crc32(const unsigned char* data, size_t size, unsigned int crc = 0);
+	static void writeUInt(ofstream& file, unsigned int value);
+	static void writeChunk(ofstream& file, const char* type, const vector<unsigned char>& data);
+};
+
+inline Image::Image(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	pixels.resize(size_t(width) * height * 3);
+}
+
+inline int Image::getWidth()
+{
+	return width;
+}
+
+inline int Image::getHeight()
+{
+	return height;
+}
+
+inline unsigned char* Image::getPixels()
+{
+	return pixels.data();
+}
+
+inline Image* Image::readFramebuffer()
+{
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	return flipVertically();
+}
+
+inline Image* Image::flipVertically()
+{
+	size_t row = size_t(width) * 3;
+	for (int i = 0; i < height / 2; i++)
+	{
+		swap_ranges(pixels.begin() + i * row, pixels.begin() + (i + 1) * row, pixels.begin() + (height - i - 1) * row);
+	}
+	return this;
+}
+
+inline Image* Image::save(string filename)
+{
+	bool png = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".png") == 0;
+	return png ? savePNG(filename) : savePPM(filename);
+}
+
+inline Image* Image::savePPM(string filename)
+{
+	ofstream file(filename, ios::binary);
+	if (!file)
+		throw "cannot open image file";
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+	file.write((const char*)pixels.data(), pixels.size());
+	return this;
+}
+
+/*
+ * Writes an uncompressed PNG (stored deflate blocks), so no zlib is needed
+ */
+inline Image* Image::savePNG(string filename)
+{
+	ofstream file(filename, ios::binary);
+	if (!file)
+		throw "cannot open image file";
+
+	const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write((const char*)signature, sizeof(signature));
+
+	vector<unsigned char> header(13, 0);
+	for (int i = 0; i < 4; i++)
+	{
+		header[i] = (width >> (24 - 8 * i)) & 0xFF;
+		header[4 + i] = (height >> (24 - 8 * i)) & 0xFF;
+	}
+	header[8] = 8;
+	header[9] = 2;
+	writeChunk(file, "IHDR", header);
+
+	size_t row = size_t(width) * 3;
+	vector<unsigned char> raw;
+	raw.reserve((row + 1) * height);
+	for (int i = 0; i < height; i++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), pixels.begin() + i * row, pixels.begin() + (i + 1) * row);
+	}
+
+	vector<unsigned char> data = { 0x78, 0x01 };
+	data.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	unsigned int a = 1, b = 0;
+	for (size_t offset = 0; offset < raw.size(); offset += 65535)
+	{
+		size_t length = std::min(raw.size() - offset, size_t(65535));
+		data.push_back(offset + length == raw.size() ? 1 : 0);
+		data.push_back(length & 0xFF);
+		data.push_back((length >> 8) & 0xFF);
+		data.push_back(~length & 0xFF);
+		data.push_back((~length >> 8) & 0xFF);
+		data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + length);
+		for (size_t i = offset; i < offset + length; i++)
+		{
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+	}
+	unsigned int adler = (b << 16) | a;
+	for (int i = 0; i < 4; i++)
+		data.push_back((adler >> (24 - 8 * i)) & 0xFF);
+	writeChunk(file, "IDAT", data);
+	writeChunk(file, "IEND", {});
+	return this;
+}
+
+inline unsigned int Image::crc32(const unsigned char* data, size_t size, unsigned int crc)
+{
+	static unsigned int table[256] = { 0 };
+	if (table[1] == 0)
+	{
+		for (unsigned int n = 0; n < 256; n++)
+		{
+			unsigned int c = n;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+inline void Image::writeUInt(ofstream& file, unsigned int value)
+{
+	unsigned char bytes[] = { (unsigned char)(value >> 24), (unsigned char)(value >> 16), (unsigned char)(value >> 8), (unsigned char)value };
+	file.write((const char*)bytes, 4);
+}
+
+inline void Image::writeChunk(ofstream& file, const char* type, const vector<unsigned char>& data)
+{
+	writeUInt(file, (unsigned int)data.size());
+	file.write(type, 4);
+	if (!data.empty())
+		file.write((const char*)data.data(), data.size());
+	unsigned int crc = crc32((const unsigned char*)type, 4);
+	crc = crc32(data.data(), data.size(), crc);
+	writeUInt(file, crc);
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+#include "Utils.h"
+#include "RigidBody.h"
+#include "StaticBatch.h"
+#include "MeshArena.h"
+#include "StreamBuffer.h"
+#include "Frustum.h"
+
+/*
+ * Renderer Submitting the whole Visible Scene with one glMultiDrawElementsIndirect
+ *
+ * Every visible body (at its level of detail) and static chunk becomes one DrawElementsIndirectCommand into the
+ * MeshArena, and its model matrices and material become one entry of the Draws storage buffer, read by the vertex
+ * shader (Shaders::INDIRECT_VERTEX_FILENAME) through gl_DrawIDARB; commands and entries stream through StreamBuffers.
+ * Needs ARB_multi_draw_indirect, ARB_shader_storage_buffer_object and ARB_shader_draw_parameters
+ */
+class IndirectRenderer
+{
+public:
+	static const GLuint DRAWS_BINDING;
+	static const GLsizeiptr DEFAULT_CAPACITY;
+	static bool ENABLED;
+
+	static bool isSupported();
+
+	IndirectRenderer();
+	~IndirectRenderer();
+
+	void draw(const vector<RigidBody*>& bodies, StaticBatch* batch);
+	int getDrawCount();
+	MeshArena* getArena();
+
+private:
+	struct Draw {
+		mat4 model;
+		mat4 normalMatrix;
+		vec4 ambientProduct;
+		vec4 diffuseProduct;
+		vec4 specularProduct;
+		vec4 shininess;
+	};
+
+	struct Item {
+		Shape* shape;
+		int subMesh;
+		mat4 model;
+		Material material;
+	};
+
+	MeshArena arena;
+	StreamBuffer* commandsStream;
+	StreamBuffer* drawsStream;
+	GLint alignment;
+	vector<Item> items;
+	vector<MeshArena::Command> commands;
+	vector<Draw> draws;
+	vector<Shape*> chunks;
+
+	void addItem(Shape* shape, int subMesh, const mat4& model, Material material);
+};
+
+const GLuint IndirectRenderer::DRAWS_BINDING = 1;
+const GLsizeiptr IndirectRenderer::DEFAULT_CAPACITY = 4096;
+bool IndirectRenderer::ENABLED = false;
+
+inline bool IndirectRenderer::isSupported()
+{
+	return GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_shader_draw_parameters;
+}
+
+inline IndirectRenderer::IndirectRenderer()
+{
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment = std::max<GLint>(alignment, 1);
+	commandsStream = new StreamBuffer(DEFAULT_CAPACITY * sizeof(MeshArena::Command));
+	drawsStream = new StreamBuffer(DEFAULT_CAPACITY * sizeof(Draw));
+}
+
+inline IndirectRenderer::~IndirectRenderer()
+{
+	delete commandsStream;
+	delete drawsStream;
+}
+
+/*
+ * Culls and collects the draws, makes sure the arena holds all their shapes, then streams and submits them
+ */
+inline void IndirectRenderer::draw(const vector<RigidBody*>& bodies, StaticBatch* batch)
+{
+	Frustum frustum(Program::getProjection()->getMatrix() * Program::getView()->getMatrix());
+	items.clear();
+	commands.clear();
+	draws.clear();
+	for (RigidBody* body : bodies)
+	{
+		Shape* shape = body->getShape();
+		if (shape == NULL || batch->contains(body))
+			continue;
+
+		if (!frustum.intersects(body->getPosition(), body->getBoundingRadius()))
+			continue;
+
+		Material material = body->isSelected() ? World::SELECTED_MATERIAL : World::DEFAULT_MATERIAL;
+		int level = body->selectLevel();
+		if (level >= 0)
+			addItem(shape, level, body->getTransform(), material);
+		else
+			for (int i = 0; i < (int)shape->getSubMeshes()->size(); i++)
+				addItem(shape, i, body->getTransform(), material);
+	}
+	chunks.clear();
+	batch->collect(&frustum, &chunks);
+	for (Shape* chunk : chunks)
+		addItem(chunk, 0, Model::IDENTITY, World::DEFAULT_MATERIAL);
+	if (items.empty())
+		return;
+
+	arena.beginFrame();
+	for (Item& item : items)
+		arena.require(item.shape);
+
+	for (Item& item : items)
+	{
+		Material m = item.material;
+		commands.push_back(arena.getCommand(item.shape, item.subMesh));
+		draws.push_back({
+			item.model,
+			mat4(transpose(inverse(mat3(item.model)))),
+			vec4(World::DEFAULT_LIGHT.ambient * m.ambient, 0.0f),
+			vec4(World::DEFAULT_LIGHT.diffuse * m.diffuse, 0.0f),
+			vec4(World::DEFAULT_LIGHT.specular * m.specular, 0.0f),
+			vec4(m.shininess)
+		});
+	}
+
+	GLintptr commandsOffset = StreamBuffer::append(&commandsStream, commands.data(), commands.size() * sizeof(MeshArena::Command), sizeof(MeshArena::Command));
+	GLintptr drawsOffset = StreamBuffer::append(&drawsStream, draws.data(), draws.size() * sizeof(Draw), alignment);
+
+	glBindVertexArray(arena.getVAO());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandsStream->getBuffer());
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAWS_BINDING, drawsStream->getBuffer(), drawsOffset, draws.size() * sizeof(Draw));
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)commandsOffset, commands.size(), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+/*
+ * Number of commands submitted in the last frame
+ */
+inline int IndirectRenderer::getDrawCount()
+{
+	return commands.size();
+}
+
+inline MeshArena* IndirectRenderer::getArena()
+{
+	return &arena;
+}
+
+inline void IndirectRenderer::addItem(Shape* shape, int subMesh, const mat4& model, Material material)
+{
+	items.push_back({ shape, subMesh, model, material });
+}
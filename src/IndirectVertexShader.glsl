@@ -0,0 +1,61 @@
+#version 420 core
+#extension GL_ARB_shader_storage_buffer_object : require
+#extension GL_ARB_shader_draw_parameters : require
+
+// features defined by ShaderVariants: VERTEX_COLORS, LIGHTS (lit per vertex, the materials come with the draws)
+#ifndef LIGHTS
+#define LIGHTS 1
+#endif
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 vertexNormal;
+#ifdef VERTEX_COLORS
+layout(location = 2) in vec4 vertexColor;
+#endif
+
+struct Draw {
+	mat4 model;
+	mat4 normalMatrix;
+	vec4 ambientProduct;
+	vec4 diffuseProduct;
+	vec4 specularProduct;
+	vec4 shininess;
+};
+
+layout(std430, binding = 1) readonly buffer Draws {
+	Draw draws[];
+};
+
+uniform float time;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 eyePosition;
+uniform vec3 lightPosition[LIGHTS];
+uniform float lightCount;
+
+out vec4 Color;
+
+void main()
+{
+	Draw draw = draws[gl_DrawIDARB];
+#ifdef VERTEX_COLORS
+	vec4 base = vertexColor;
+#else
+	vec4 base = vec4(1.0);
+#endif
+
+	vec3 M = (draw.model * vec4(vertexPosition, 1.0)).xyz;
+	vec3 N = normalize(mat3(draw.normalMatrix) * vertexNormal);
+	vec3 V = normalize(eyePosition - M);
+	vec3 light = draw.ambientProduct.xyz;
+	for (int i = 0; i < min(int(lightCount), LIGHTS); i++)
+	{
+		vec3 L = normalize(lightPosition[i] - M);
+		vec3 R = -normalize(reflect(L, N));
+		light += draw.diffuseProduct.xyz * max(dot(L, N), 0.0);
+		light += draw.specularProduct.xyz * pow(max(dot(R, V), 0.0), draw.shininess.x);
+	}
+
+	gl_Position = projection * view * draw.model * vec4(vertexPosition, 1.0);
+	Color = vec4(base.rgb * light, base.a);
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+#include "Utils.h"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <thread>
+
+/*
+ * Binary Recorder and Replayer for Input Events
+ *
+ * A trace is a header (magic, version, RNG seed) followed by fixed-size events,
+ * each one stamped with the microseconds elapsed since the recording started
+ */
+class InputTrace
+{
+public:
+	enum Type { FRAME = 0, RESIZE = 1, KEY_PRESSED = 2, KEY_RELEASED = 3, SPECIAL_KEY = 4, MOUSE_PRESSED = 5, MOUSE_MOTION = 6, MOUSE_PASSIVE = 7, MOUSE_WHEEL = 8, MENU = 9 };
+
+	struct Event {
+		int64_t time;
+		int32_t type;
+		int32_t a, b, c, d;
+		int32_t modifiers;
+	};
+
+	static const char MAGIC[4];
+	static const uint32_t VERSION;
+
+	static void startRecording(string filename, unsigned int seed);
+	static void stopRecording();
+	static bool isRecording();
+	static bool isReplaying();
+	static void record(Type type, int a = 0, int b = 0, int c = 0, int d = 0);
+	static int getModifiers();
+
+	static vector<Event> load(string filename, unsigned int* seed);
+	static void replay(vector<Event>* events, bool realtime, function<bool(Event)> dispatch);
+
+private:
+	InputTrace();
+
+	static ofstream output;
+	static chrono::steady_clock::time_point start;
+	static bool replaying;
+	static int modifiers;
+};
+
+const char InputTrace::MAGIC[4] = { 'B', '1', 'I', 'T' };
+const uint32_t InputTrace::VERSION = 1;
+ofstream InputTrace::output;
+chrono::steady_clock::time_point InputTrace::start;
+bool InputTrace::replaying = false;
+int InputTrace::modifiers = 0;
+
+inline void InputTrace::startRecording(string filename, unsigned int seed)
+{
+	output.open(filename, ios::binary | ios::trunc);
+	if (!output)
+		throw "cannot open input trace";
+
+	uint32_t s = seed;
+	output.write(MAGIC, sizeof(MAGIC));
+	output.write((const char*)&VERSION, sizeof(VERSION));
+	output.write((const char*)&s, sizeof(s));
+	start = chrono::steady_clock::now();
+}
+
+inline void InputTrace::stopRecording()
+{
+	if (output.is_open())
+		output.close();
+}
+
+inline bool InputTrace::isRecording()
+{
+	return output.is_open();
+}
+
+inline bool InputTrace::isReplaying()
+{
+	return replaying;
+}
+
+/*
+ * Modifiers are only sampled from key and mouse button events, where GLUT allows reading them
+ */
+inline void InputTrace::record(Type type, int a, int b, int c, int d)
+{
+	if (!isRecording())
+		return;
+
+	Event event;
+	event.time = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+	event.type = type;
+	event.a = a;
+	event.b = b;
+	event.c = c;
+	event.d = d;
+	event.modifiers = (type == KEY_PRESSED || type == KEY_RELEASED || type == SPECIAL_KEY || type == MOUSE_PRESSED) ? getModifiers() : 0;
+	output.write((const char*)&event, sizeof(Event));
+}
+
+inline int InputTrace::getModifiers()
+{
+	return replaying ? modifiers : glutGetModifiers();
+}
+
+inline vector<InputTrace::Event> InputTrace::load(string filename, unsigned int* seed)
+{
+	ifstream input(filename, ios::binary);
+	char magic[4];
+	uint32_t version, s;
+	if (!input.read(magic, sizeof(magic)) || !equal(magic, magic + 4, MAGIC))
+		throw "not an input trace";
+	input.read((char*)&version, sizeof(version));
+	input.read((char*)&s, sizeof(s));
+	if (!input || version != VERSION)
+		throw "unsupported input trace version";
+
+	vector<Event> events;
+	Event event;
+	while (input.read((char*)&event, sizeof(Event)))
+		events.push_back(event);
+
+	*seed = s;
+	return events;
+}
+
+/*
+ * Feeds the events in order, as fast as possible or waiting for their recorded timestamps
+ */
+inline void InputTrace::replay(vector<Event>* events, bool realtime, function<bool(Event)> dispatch)
+{
+	replaying = true;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	for (Event event : *events)
+	{
+		if (realtime)
+			this_thread::sleep_until(begin + chrono::microseconds(event.time));
+
+		modifiers = event.modifiers;
+		if (!dispatch(event))
+			break;
+	}
+	modifiers = 0;
+	replaying = false;
+}
\ No newline at end of file
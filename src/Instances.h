@@ -0,0 +1,106 @@
+#pragma once
+#include "Utils.h"
+#include "StreamBuffer.h"
+
+/*
+ * Per-Draw Instance Data Streamed to the Instance Uniform Block of the Vertex Shader
+ *
+ * Every push writes the model and normal matrices into the current frame region of a StreamBuffer and binds that range
+ * to BINDING, instead of setting the model uniforms of the program; the buffer starts with room for DEFAULT_CAPACITY
+ * draws per frame and grows when a frame needs more. Instanced shaders read the same data as per-instance attributes
+ * instead, the model matrix at ATTRIBUTE and the normal matrix after it, once bindAttributes points the vertex array
+ * at the last push (one instance per model pushed)
+ */
+class Instances
+{
+public:
+	static const GLuint BINDING;
+	static const GLsizeiptr DEFAULT_CAPACITY;
+	static const GLuint ATTRIBUTE;
+
+	static void push(const mat4& model);
+	static void push(const vector<mat4>& models);
+	static void bindAttributes();
+	static void free();
+
+private:
+	struct Instance {
+		mat4 model;
+		mat4 normalMatrix;
+	};
+
+	Instances();
+
+	static StreamBuffer* buffer;
+	static GLint alignment;
+	static GLintptr offset;
+	static vector<Instance> staging;
+
+	static void upload();
+};
+
+const GLuint Instances::BINDING = 0;
+const GLsizeiptr Instances::DEFAULT_CAPACITY = 1024;
+const GLuint Instances::ATTRIBUTE = 3;
+StreamBuffer* Instances::buffer = NULL;
+GLint Instances::alignment = 0;
+GLintptr Instances::offset = 0;
+vector<Instances::Instance> Instances::staging;
+
+inline void Instances::push(const mat4& model)
+{
+	staging.assign(1, { model, mat4(transpose(inverse(mat3(model)))) });
+	upload();
+}
+
+/*
+ * Pushes the instances contiguously, the first one bound to the uniform block
+ */
+inline void Instances::push(const vector<mat4>& models)
+{
+	if (models.empty())
+		return;
+
+	staging.clear();
+	for (const mat4& model : models)
+		staging.push_back({ model, mat4(transpose(inverse(mat3(model)))) });
+	upload();
+}
+
+/*
+ * Points the instance attributes of the vertex array bound at the instances of the last push, advancing once per
+ * instance drawn
+ */
+inline void Instances::bindAttributes()
+{
+	if (buffer == NULL)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer->getBuffer());
+	for (GLuint column = 0; column < 8; column++)
+	{
+		glEnableVertexAttribArray(ATTRIBUTE + column);
+		glVertexAttribPointer(ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void*)(offset + column * sizeof(vec4)));
+		glVertexAttribDivisor(ATTRIBUTE + column, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+inline void Instances::upload()
+{
+	if (buffer == NULL)
+	{
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		alignment = std::max<GLint>(alignment, 1);
+		buffer = new StreamBuffer(DEFAULT_CAPACITY * ((sizeof(Instance) + alignment - 1) / alignment * alignment));
+	}
+
+	offset = StreamBuffer::append(&buffer, staging.data(), staging.size() * sizeof(Instance), alignment);
+	glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, buffer->getBuffer(), offset, sizeof(Instance));
+}
+
+inline void Instances::free()
+{
+	delete buffer;
+	buffer = NULL;
+}
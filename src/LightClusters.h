@@ -0,0 +1,212 @@
+#pragma once
+#include "Utils.h"
+#include "Shader.h"
+#include "Global.h"
+#include "Projection.h"
+#include "StreamBuffer.h"
+
+/*
+ * Grid of View Frustum Clusters (Froxels) Listing the Point and Spot Lights that Reach Each of them
+ *
+ * The frustum is split into GRID_X by GRID_Y screen tiles and GRID_Z slices growing exponentially from the near to the far
+ * plane. build tests the bounding sphere of every light against the view-space box of the clusters in its slice range and
+ * streams three storage buffers: the lights, an (offset, count) pair per cluster and the light indices of all clusters;
+ * the CLUSTERED fragment shader finds its cluster from gl_FragCoord and its view depth and loops over those lights only
+ */
+class LightClusters
+{
+public:
+	static const int GRID_X = 16;
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const GLuint LIGHTS_BINDING;
+	static const GLuint CLUSTERS_BINDING;
+	static const GLuint INDICES_BINDING;
+	static const GLsizeiptr DEFAULT_CAPACITY;
+
+	static bool isSupported();
+
+	LightClusters();
+	~LightClusters();
+
+	LightClusters* build(const vector<PointLight>& lights, const mat4& view, Projection* projection);
+	void bind(Shader* shader);
+	int getAssignments();
+
+private:
+	struct GpuLight {
+		vec4 positionRadius;
+		vec4 colorCutoff;
+		vec4 direction;
+	};
+
+	struct Range {
+		GLuint offset, count;
+	};
+
+	vector<GpuLight> gpuLights;
+	vector<Range> ranges;
+	vector<GLuint> indices;
+	vector<vector<GLuint>> lists;
+	vec3 low[GRID_X * GRID_Y * GRID_Z], high[GRID_X * GRID_Y * GRID_Z];
+	double fieldOfView, aspectRatio, zNear, zFar;
+	StreamBuffer* lightsStream;
+	StreamBuffer* clustersStream;
+	StreamBuffer* indicesStream;
+	GLintptr lightsOffset, clustersOffset, indicesOffset;
+	GLint alignment;
+
+	void computeBounds(Projection* projection);
+	int getSlice(double depth);
+	static int getIndex(int x, int y, int z);
+};
+
+const GLuint LightClusters::LIGHTS_BINDING = 2;
+const GLuint LightClusters::CLUSTERS_BINDING = 3;
+const GLuint LightClusters::INDICES_BINDING = 4;
+const GLsizeiptr LightClusters::DEFAULT_CAPACITY = 4096;
+
+inline bool LightClusters::isSupported()
+{
+	return GLEW_ARB_shader_storage_buffer_object;
+}
+
+inline LightClusters::LightClusters()
+{
+	fieldOfView = aspectRatio = zNear = zFar = 0.0;
+	lightsOffset = clustersOffset = indicesOffset = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment = std::max<GLint>(alignment, 1);
+	lists.resize(GRID_X * GRID_Y * GRID_Z);
+	lightsStream = new StreamBuffer(DEFAULT_CAPACITY * sizeof(GpuLight));
+	clustersStream = new StreamBuffer(GRID_X * GRID_Y * GRID_Z * sizeof(Range));
+	indicesStream = new StreamBuffer(DEFAULT_CAPACITY * sizeof(GLuint));
+}
+
+inline LightClusters::~LightClusters()
+{
+	delete lightsStream;
+	delete clustersStream;
+	delete indicesStream;
+}
+
+/*
+ * Assigns the lights to the clusters of the current frame and streams the result (StreamBuffer::beginFrame must have
+ * been called); the buffers are never empty, so that their ranges can always be bound
+ */
+inline LightClusters* LightClusters::build(const vector<PointLight>& lights, const mat4& view, Projection* projection)
+{
+	computeBounds(projection);
+	gpuLights.clear();
+	for (vector<GLuint>& list : lists)
+		list.clear();
+
+	for (const PointLight& light : lights)
+	{
+		vec4 viewPosition = view * vec4(light.position, 1.0f);
+		vec3 center = vec3(viewPosition.x, viewPosition.y, viewPosition.z);
+		double depth = -center.z;
+		float r = light.radius;
+		if (r <= 0.0f || depth + r < zNear || depth - r > zFar)
+			continue;
+
+		GLuint index = gpuLights.size();
+		gpuLights.push_back({ vec4(light.position, r), vec4(light.color, light.cutoff), vec4(normalize(light.direction), 0.0f) });
+		int first = getSlice(std::max(depth - r, zNear)), last = getSlice(std::min(depth + r, zFar));
+		for (int z = first; z <= last; z++)
+			for (int y = 0; y < GRID_Y; y++)
+				for (int x = 0; x < GRID_X; x++)
+				{
+					int c = getIndex(x, y, z);
+					vec3 nearest = glm::clamp(center, low[c], high[c]);
+					if (distance(nearest, center) <= r)
+						lists[c].push_back(index);
+				}
+	}
+
+	ranges.clear();
+	indices.clear();
+	for (vector<GLuint>& list : lists)
+	{
+		ranges.push_back({ (GLuint)indices.size(), (GLuint)list.size() });
+		indices.insert(indices.end(), list.begin(), list.end());
+	}
+	if (gpuLights.empty())
+		gpuLights.push_back({ vec4(0.0f), vec4(0.0f), vec4(0.0f) });
+	if (indices.empty())
+		indices.push_back(0);
+
+	lightsOffset = StreamBuffer::append(&lightsStream, gpuLights.data(), gpuLights.size() * sizeof(GpuLight), alignment);
+	clustersOffset = StreamBuffer::append(&clustersStream, ranges.data(), ranges.size() * sizeof(Range), alignment);
+	indicesOffset = StreamBuffer::append(&indicesStream, indices.data(), indices.size() * sizeof(GLuint), alignment);
+	return this;
+}
+
+/*
+ * Binds the buffers of the last build and sets the uniforms mapping fragments to clusters on the shader (the current one)
+ */
+inline void LightClusters::bind(Shader* shader)
+{
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHTS_BINDING, lightsStream->getBuffer(), lightsOffset, gpuLights.size() * sizeof(GpuLight));
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, CLUSTERS_BINDING, clustersStream->getBuffer(), clustersOffset, ranges.size() * sizeof(Range));
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INDICES_BINDING, indicesStream->getBuffer(), indicesOffset, indices.size() * sizeof(GLuint));
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	float logRatio = float(log(zFar / zNear));
+	shader->setUniformVec4(Shaders::CLUSTER_SCALE_VARIABLE, vec4(
+		float(GRID_X) / std::max(viewport[2], 1),
+		float(GRID_Y) / std::max(viewport[3], 1),
+		GRID_Z / logRatio,
+		GRID_Z * float(log(zNear)) / logRatio
+	))->setUniformVec4(Shaders::CLUSTER_GRID_VARIABLE, vec4(GRID_X, GRID_Y, GRID_Z, 0.0f));
+}
+
+/*
+ * Number of light-cluster pairs of the last build
+ */
+inline int LightClusters::getAssignments()
+{
+	return indices.size();
+}
+
+/*
+ * View-space boxes of the clusters, recomputed only when the projection changes
+ */
+inline void LightClusters::computeBounds(Projection* projection)
+{
+	Pair<double, double> planes = projection->getPlanes();
+	if (projection->getFieldOfView() == fieldOfView && projection->getAspectRatio() == aspectRatio && planes.first == zNear && planes.second == zFar)
+		return;
+	fieldOfView = projection->getFieldOfView();
+	aspectRatio = projection->getAspectRatio();
+	zNear = planes.first;
+	zFar = planes.second;
+
+	double tanY = tan(fieldOfView / 2.0), tanX = tanY * aspectRatio;
+	for (int z = 0; z < GRID_Z; z++)
+	{
+		double front = zNear * pow(zFar / zNear, double(z) / GRID_Z), back = zNear * pow(zFar / zNear, double(z + 1) / GRID_Z);
+		for (int y = 0; y < GRID_Y; y++)
+			for (int x = 0; x < GRID_X; x++)
+			{
+				double left = -1.0 + 2.0 * x / GRID_X, right = -1.0 + 2.0 * (x + 1) / GRID_X;
+				double bottom = -1.0 + 2.0 * y / GRID_Y, top = -1.0 + 2.0 * (y + 1) / GRID_Y;
+				int c = getIndex(x, y, z);
+				// the side planes go through the eye, so the box spans the tile at both depths
+				low[c] = vec3(std::min(left * tanX * front, left * tanX * back), std::min(bottom * tanY * front, bottom * tanY * back), -back);
+				high[c] = vec3(std::max(right * tanX * front, right * tanX * back), std::max(top * tanY * front, top * tanY * back), -front);
+			}
+	}
+}
+
+inline int LightClusters::getSlice(double depth)
+{
+	int slice = int(floor(log(depth / zNear) / log(zFar / zNear) * GRID_Z));
+	return std::max(0, std::min(GRID_Z - 1, slice));
+}
+
+inline int LightClusters::getIndex(int x, int y, int z)
+{
+	return x + GRID_X * (y + GRID_Y * z);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "Utils.h"
+#include "Shape.h"
+
+/*
+ * Chain of Tessellation Levels of the same Shape, from the finest to the coarsest, packed as sub-meshes of one buffer
+ *
+ * Each level is used while the body covers at least its screen size (fraction of the viewport height);
+ * a body only switches level once it is HYSTERESIS beyond the threshold, so it does not flicker on the boundary
+ */
+class LodShape : public Shape
+{
+public:
+	static const double HYSTERESIS;
+
+	LodShape(vector<Shape*> levels, vector<double> screenSizes);
+	virtual void draw(function<void()> &uniformVariableRoutine);
+
+	virtual int getLevels();
+	virtual void selectLevel(double screenSize, int* level);
+
+private:
+	vector<double> screenSizes;
+};
+
+const double LodShape::HYSTERESIS = 0.15;
+
+/*
+ * The levels are copied into the chain and deleted
+ */
+inline LodShape::LodShape(vector<Shape*> levels, vector<double> screenSizes) : Shape(levels)
+{
+	if (levels.empty() || levels.size() != screenSizes.size())
+		throw "every level needs a screen size";
+
+	this->screenSizes = screenSizes;
+	this->screenSizes.back() = 0.0;
+	for (Shape* level : levels)
+		delete level;
+}
+
+inline void LodShape::draw(function<void()>& uniformVariableRoutine)
+{
+	drawSubMesh(0, uniformVariableRoutine);
+}
+
+inline int LodShape::getLevels()
+{
+	return screenSizes.size();
+}
+
+inline void LodShape::selectLevel(double screenSize, int* level)
+{
+	int l = glm::clamp(*level, 0, getLevels() - 1);
+	while (l > 0 && screenSize >= screenSizes[l - 1] * (1.0 + HYSTERESIS))
+		l--;
+	while (l < getLevels() - 1 && screenSize < screenSizes[l] * (1.0 - HYSTERESIS))
+		l++;
+	*level = l;
+}
\ No newline at end of file
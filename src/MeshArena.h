@@ -0,0 +1,220 @@
+#pragma once
+#include "Utils.h"
+#include "Shape.h"
+#include <unordered_map>
+
+/*
+ * Shared Vertex and Index Buffers Holding the Triangles of Many Shapes
+ *
+ * A shape is appended on first use and every one of its sub-meshes becomes a Command (a DrawElementsIndirectCommand
+ * into the arena, with 32-bit indices relative to baseVertex), so that draws of different shapes go out in one
+ * multi-draw. Shapes are keyed by address and version, so a shape uploaded again (or a new one allocated at the address
+ * of a deleted one) is appended anew; when the arena is full it is rebuilt with the shapes required in the current
+ * frame only, which drops the deleted ones. Hence every shape of a frame must be required before its commands are read
+ */
+class MeshArena
+{
+public:
+	struct Command {
+		GLuint count, instanceCount, firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	static const GLuint DEFAULT_VERTICES;
+
+	MeshArena();
+	~MeshArena();
+
+	void beginFrame();
+	void require(Shape* shape);
+	Command getCommand(Shape* shape, int subMesh);
+	GLuint getVAO();
+	GLuint getVertices();
+	GLuint getIndices();
+
+private:
+	struct Entry {
+		unsigned long version;
+		unsigned long frame;
+		vector<Command> commands;
+	};
+
+	GLuint arenaVAO, verticesVBO, normalsVBO, colorsVBO, indicesVBO;
+	GLuint vertexCapacity, indexCapacity;
+	GLuint vertexCount, indexCount;
+	unordered_map<Shape*, Entry> entries;
+	unsigned long frame;
+
+	void append(Shape* shape, Entry* entry);
+	void rebuild(GLuint vertices, GLuint indices);
+	void createBuffers();
+	void deleteBuffers();
+};
+
+const GLuint MeshArena::DEFAULT_VERTICES = 1 << 16;
+
+inline MeshArena::MeshArena()
+{
+	frame = 0;
+	vertexCount = indexCount = 0;
+	vertexCapacity = DEFAULT_VERTICES;
+	indexCapacity = 6 * DEFAULT_VERTICES;
+	createBuffers();
+}
+
+inline MeshArena::~MeshArena()
+{
+	deleteBuffers();
+}
+
+inline void MeshArena::beginFrame()
+{
+	frame++;
+}
+
+inline void MeshArena::require(Shape* shape)
+{
+	unordered_map<Shape*, Entry>::iterator entry = entries.find(shape);
+	if (entry != entries.end() && entry->second.version == shape->getVersion())
+	{
+		entry->second.frame = frame;
+		return;
+	}
+	if (!shape->hasMirror())
+		throw "cannot add a shape without its CPU mirror to the arena";
+
+	GLuint vertices = shape->getVertices()->size(), indices = 3 * shape->getIndices()->size();
+	if (vertexCount + vertices > vertexCapacity || indexCount + indices > indexCapacity)
+	{
+		entries.erase(shape);
+		rebuild(vertices, indices);
+	}
+
+	Entry& added = entries[shape];
+	added = { shape->getVersion(), frame, {} };
+	append(shape, &added);
+}
+
+inline MeshArena::Command MeshArena::getCommand(Shape* shape, int subMesh)
+{
+	return entries.at(shape).commands.at(subMesh);
+}
+
+inline GLuint MeshArena::getVAO()
+{
+	return arenaVAO;
+}
+
+inline GLuint MeshArena::getVertices()
+{
+	return vertexCount;
+}
+
+inline GLuint MeshArena::getIndices()
+{
+	return indexCount;
+}
+
+/*
+ * The triangles of each sub-mesh are stored after those of the previous one, relative to the sub-mesh first vertex
+ */
+inline void MeshArena::append(Shape* shape, Entry* entry)
+{
+	GLuint vertices = shape->getVertices()->size();
+	glBindBuffer(GL_ARRAY_BUFFER, verticesVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, vertexCount * sizeof(Point), vertices * sizeof(Point), shape->getVertices()->data());
+	glBindBuffer(GL_ARRAY_BUFFER, normalsVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, vertexCount * sizeof(Point), vertices * sizeof(Point), shape->getNormals()->data());
+	glBindBuffer(GL_ARRAY_BUFFER, colorsVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, vertexCount * sizeof(Color), vertices * sizeof(Color), shape->getColors()->data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	vector<GLuint> elements;
+	elements.reserve(3 * shape->getIndices()->size());
+	for (Shape::SubMesh subMesh : *shape->getSubMeshes())
+	{
+		entry->commands.push_back({ 3 * subMesh.triangleCount, 1, indexCount + (GLuint)elements.size(), GLint(vertexCount + subMesh.firstVertex), 0 });
+		for (GLuint t = subMesh.firstTriangle; t < subMesh.firstTriangle + subMesh.triangleCount; t++)
+		{
+			Index triangle = shape->getIndices()->at(t);
+			elements.insert(elements.end(), { triangle.i - subMesh.firstVertex, triangle.j - subMesh.firstVertex, triangle.k - subMesh.firstVertex });
+		}
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indicesVBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, indexCount * sizeof(GLuint), elements.size() * sizeof(GLuint), elements.data());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	vertexCount += vertices;
+	indexCount += elements.size();
+}
+
+/*
+ * Keeps only the shapes required in this frame, with room for twice them plus the shape being added
+ */
+inline void MeshArena::rebuild(GLuint vertices, GLuint indices)
+{
+	vector<Shape*> kept;
+	for (pair<Shape* const, Entry>& entry : entries)
+	{
+		if (entry.second.frame == frame)
+		{
+			kept.push_back(entry.first);
+			vertices += entry.first->getVertices()->size();
+			indices += 3 * entry.first->getIndices()->size();
+		}
+	}
+
+	deleteBuffers();
+	entries.clear();
+	vertexCount = indexCount = 0;
+	vertexCapacity = std::max(DEFAULT_VERTICES, 2 * vertices);
+	indexCapacity = std::max(6 * DEFAULT_VERTICES, 2 * indices);
+	createBuffers();
+	for (Shape* shape : kept)
+	{
+		Entry& entry = entries[shape];
+		entry = { shape->getVersion(), frame, {} };
+		append(shape, &entry);
+	}
+}
+
+inline void MeshArena::createBuffers()
+{
+	glGenVertexArrays(1, &arenaVAO);
+	glBindVertexArray(arenaVAO);
+
+	glGenBuffers(1, &verticesVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, verticesVBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(Point), NULL, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 0, 0);
+
+	glGenBuffers(1, &normalsVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, normalsVBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(Point), NULL, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_DOUBLE, GL_FALSE, 0, 0);
+
+	glGenBuffers(1, &colorsVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, colorsVBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(Color), NULL, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_DOUBLE, GL_FALSE, 0, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &indicesVBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indicesVBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+}
+
+inline void MeshArena::deleteBuffers()
+{
+	glDeleteVertexArrays(1, &arenaVAO);
+	glDeleteBuffers(1, &verticesVBO);
+	glDeleteBuffers(1, &normalsVBO);
+	glDeleteBuffers(1, &colorsVBO);
+	glDeleteBuffers(1, &indicesVBO);
+}
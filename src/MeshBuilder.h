@@ -0,0 +1,134 @@
+#pragma once
+#include "Utils.h"
+#include "Shape.h"
+
+/*
+ * Builder of the Arrays of a Shape
+ *
+ * Geometry is written in place, through add or straight into the arrays returned by the getters (as Parametric and
+ * Normals do), and build moves the arrays into the Shape without copying them; with setMirror(false) the Shape also
+ * frees them once uploaded, and with setOptimize(false) it skips the MeshOptimizer pass
+ */
+class MeshBuilder
+{
+public:
+	MeshBuilder();
+	MeshBuilder* reserve(size_t vertices, size_t triangles);
+	GLuint addVertex(Point position, Point normal, Color color);
+	MeshBuilder* addTriangle(GLuint i, GLuint j, GLuint k);
+	MeshBuilder* fillColors(Optional<Color> c);
+	MeshBuilder* setMirror(bool mirror);
+	MeshBuilder* setOptimize(bool optimize);
+
+	vector<Point>* getVertices();
+	vector<Point>* getNormals();
+	vector<Color>* getColors();
+	vector<Index>* getIndices();
+	vector<GLuint>* getStrips();
+	Shape* build();
+
+private:
+	vector<Point> vertices;
+	vector<Point> normals;
+	vector<Color> colors;
+	vector<Index> indices;
+	vector<GLuint> strips;
+	bool mirror;
+	bool optimize;
+};
+
+inline MeshBuilder::MeshBuilder()
+{
+	mirror = true;
+	optimize = true;
+}
+
+inline MeshBuilder* MeshBuilder::reserve(size_t vertices, size_t triangles)
+{
+	this->vertices.reserve(vertices);
+	this->normals.reserve(vertices);
+	this->colors.reserve(vertices);
+	this->indices.reserve(triangles);
+	return this;
+}
+
+inline GLuint MeshBuilder::addVertex(Point position, Point normal, Color color)
+{
+	vertices.push_back(position);
+	normals.push_back(normal);
+	colors.push_back(color);
+	return vertices.size() - 1;
+}
+
+inline MeshBuilder* MeshBuilder::addTriangle(GLuint i, GLuint j, GLuint k)
+{
+	indices.push_back({ i, j, k });
+	return this;
+}
+
+/*
+ * Gives the vertices with no color yet c, or a random color each when c is empty
+ */
+inline MeshBuilder* MeshBuilder::fillColors(Optional<Color> c)
+{
+	colors.reserve(vertices.size());
+	while (colors.size() < vertices.size())
+		colors.push_back(c.orElse({ rand(0.0, 1.0), rand(0.0, 1.0), rand(0.0, 1.0), 1.0 }));
+	return this;
+}
+
+inline MeshBuilder* MeshBuilder::setMirror(bool mirror)
+{
+	this->mirror = mirror;
+	return this;
+}
+
+inline MeshBuilder* MeshBuilder::setOptimize(bool optimize)
+{
+	this->optimize = optimize;
+	return this;
+}
+
+inline vector<Point>* MeshBuilder::getVertices()
+{
+	return &vertices;
+}
+
+inline vector<Point>* MeshBuilder::getNormals()
+{
+	return &normals;
+}
+
+inline vector<Color>* MeshBuilder::getColors()
+{
+	return &colors;
+}
+
+inline vector<Index>* MeshBuilder::getIndices()
+{
+	return &indices;
+}
+
+inline vector<GLuint>* MeshBuilder::getStrips()
+{
+	return &strips;
+}
+
+/*
+ * Leaves the builder empty; missing normals default to zero and missing colors to white
+ */
+inline Shape* MeshBuilder::build()
+{
+	normals.resize(vertices.size(), { 0.0, 0.0, 0.0 });
+	colors.resize(vertices.size(), { 1.0, 1.0, 1.0, 1.0 });
+	Shape* shape = new Shape(std::move(vertices), std::move(normals), std::move(colors), std::move(indices), std::move(strips), optimize);
+	if (!mirror)
+		shape->releaseMirror();
+
+	vertices.clear();
+	normals.clear();
+	colors.clear();
+	indices.clear();
+	strips.clear();
+	return shape;
+}
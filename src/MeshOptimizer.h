@@ -0,0 +1,339 @@
+#pragma once
+#include "Utils.h"
+#include <algorithm>
+#include <numeric>
+
+/*
+ * Mesh Optimization Pipeline, run on the triangles and vertices of a Shape before uploading them
+ *
+ * 1. vertex cache: triangles are reordered greedily by the score of their vertices in a simulated LRU cache (Forsyth)
+ * 2. overdraw: the reordered triangles are split into clusters, which are sorted so that the ones facing outwards
+ *    (thus likely to occlude the others) are drawn first, accepting a slightly worse cache locality (Sander et al.)
+ * 3. vertex fetch: vertices are renumbered in order of first use
+ * ACMR (average cache miss ratio, i.e. vertex shader invocations per triangle) is measured on a FIFO cache
+ */
+class MeshOptimizer
+{
+public:
+	struct Report {
+		double acmrBefore = 0.0;
+		double acmrAfter = 0.0;
+	};
+
+	static const int CACHE_SIZE;
+	static const double OVERDRAW_THRESHOLD;
+
+	static Report optimize(vector<Point>* vertices, vector<Index>* indices, vector<GLuint>* remap);
+	static double acmr(const vector<Index>& indices, size_t vertexCount, int cacheSize = CACHE_SIZE);
+	static void optimizeVertexCache(vector<Index>* indices, size_t vertexCount);
+	static void optimizeOverdraw(vector<Index>* indices, const vector<Point>& vertices, double threshold = OVERDRAW_THRESHOLD);
+	static vector<GLuint> optimizeVertexFetch(vector<Point>* vertices, vector<Index>* indices);
+	template <class T> static void remapAttribute(vector<T>* attribute, const vector<GLuint>& remap);
+
+private:
+	static const int SCORE_CACHE_SIZE = 32;
+
+	MeshOptimizer();
+
+	static vector<int> cacheMisses(const vector<Index>& indices, size_t vertexCount, int cacheSize);
+	static float vertexScore(int cachePosition, unsigned int remainingTriangles);
+};
+
+const int MeshOptimizer::CACHE_SIZE = 16;
+const double MeshOptimizer::OVERDRAW_THRESHOLD = 1.05;
+
+/*
+ * Runs the whole pipeline, remap receiving the old index of every new vertex
+ */
+inline MeshOptimizer::Report MeshOptimizer::optimize(vector<Point>* vertices, vector<Index>* indices, vector<GLuint>* remap)
+{
+	Report report;
+	report.acmrBefore = acmr(*indices, vertices->size());
+
+	// small or already well ordered meshes may not gain anything, then the previous order is kept
+	vector<Index> original = *indices;
+	optimizeVertexCache(indices, vertices->size());
+	double cacheAcmr = acmr(*indices, vertices->size());
+	if (cacheAcmr > report.acmrBefore)
+	{
+		*indices = original;
+		cacheAcmr = report.acmrBefore;
+	}
+	vector<Index> cacheOptimized = *indices;
+	optimizeOverdraw(indices, *vertices);
+	if (acmr(*indices, vertices->size()) > OVERDRAW_THRESHOLD * cacheAcmr)
+		indices->swap(cacheOptimized);
+
+	*remap = optimizeVertexFetch(vertices, indices);
+	report.acmrAfter = acmr(*indices, vertices->size());
+	return report;
+}
+
+inline double MeshOptimizer::acmr(const vector<Index>& indices, size_t vertexCount, int cacheSize)
+{
+	if (indices.empty())
+		return 0.0;
+
+	vector<int> misses = cacheMisses(indices, vertexCount, cacheSize);
+	return accumulate(misses.begin(), misses.end(), 0.0) / indices.size();
+}
+
+/*
+ * Misses of each triangle on a FIFO cache, in draw order
+ */
+inline vector<int> MeshOptimizer::cacheMisses(const vector<Index>& indices, size_t vertexCount, int cacheSize)
+{
+	vector<size_t> insertion(vertexCount, 0);
+	vector<int> misses(indices.size(), 0);
+	size_t time = cacheSize + 1;
+	for (size_t t = 0; t < indices.size(); t++)
+	{
+		GLuint corners[3] = { indices[t].i, indices[t].j, indices[t].k };
+		for (GLuint v : corners)
+		{
+			if (time - insertion[v] > (size_t)cacheSize)
+			{
+				insertion[v] = time++;
+				misses[t]++;
+			}
+		}
+	}
+	return misses;
+}
+
+inline float MeshOptimizer::vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 3)
+		score = pow(1.0f - float(cachePosition - 3) / (SCORE_CACHE_SIZE - 3), 1.5f);
+	else if (cachePosition >= 0)
+		score = 0.75f;
+	return score + 2.0f / sqrt(float(remainingTriangles));
+}
+
+inline void MeshOptimizer::optimizeVertexCache(vector<Index>* indices, size_t vertexCount)
+{
+	size_t triangles = indices->size();
+	vector<unsigned int> offsets(vertexCount + 1, 0), adjacency(3 * triangles), remaining(vertexCount, 0);
+	for (Index t : *indices)
+	{
+		offsets[t.i + 1]++;
+		offsets[t.j + 1]++;
+		offsets[t.k + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+	for (size_t t = 0; t < triangles; t++)
+	{
+		GLuint corners[3] = { indices->at(t).i, indices->at(t).j, indices->at(t).k };
+		for (GLuint v : corners)
+			adjacency[offsets[v] + remaining[v]++] = t;
+	}
+
+	vector<float> vertexScores(vertexCount), triangleScores(triangles, 0.0f);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = vertexScore(-1, remaining[v]);
+	for (size_t t = 0; t < triangles; t++)
+		triangleScores[t] = vertexScores[indices->at(t).i] + vertexScores[indices->at(t).j] + vertexScores[indices->at(t).k];
+
+	vector<bool> emitted(triangles, false);
+	vector<Index> ordered;
+	ordered.reserve(triangles);
+	vector<GLuint> cache, nextCache;
+	size_t cursor = 0;
+	long long best = -1;
+	while (ordered.size() < triangles)
+	{
+		if (best < 0)
+		{
+			while (emitted[cursor])
+				cursor++;
+			best = cursor;
+		}
+
+		Index t = indices->at(best);
+		emitted[best] = true;
+		ordered.push_back(t);
+
+		// emitted vertices move to the front of the cache, pushing out the oldest ones
+		GLuint corners[3] = { t.i, t.j, t.k };
+		nextCache.assign(corners, corners + 3);
+		for (GLuint v : corners)
+		{
+			unsigned int* first = &adjacency[offsets[v]];
+			unsigned int* last = first + remaining[v];
+			*find(first, last, (unsigned int)best) = *(last - 1);
+			remaining[v]--;
+		}
+		for (GLuint v : cache)
+			if (v != t.i && v != t.j && v != t.k)
+				nextCache.push_back(v);
+		for (size_t p = SCORE_CACHE_SIZE; p < nextCache.size(); p++)
+		{
+			GLuint v = nextCache[p];
+			float delta = vertexScore(-1, remaining[v]) - vertexScores[v];
+			vertexScores[v] += delta;
+			for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+				triangleScores[adjacency[a]] += delta;
+		}
+		if (nextCache.size() > (size_t)SCORE_CACHE_SIZE)
+			nextCache.resize(SCORE_CACHE_SIZE);
+		cache.swap(nextCache);
+
+		// only the triangles around cached vertices change score
+		best = -1;
+		float bestScore = -1.0f;
+		for (size_t p = 0; p < cache.size(); p++)
+		{
+			GLuint v = cache[p];
+			float delta = vertexScore(p, remaining[v]) - vertexScores[v];
+			vertexScores[v] += delta;
+			for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+				triangleScores[adjacency[a]] += delta;
+		}
+		for (GLuint v : cache)
+		{
+			for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+			{
+				if (triangleScores[adjacency[a]] > bestScore)
+				{
+					bestScore = triangleScores[adjacency[a]];
+					best = adjacency[a];
+				}
+			}
+		}
+	}
+	indices->swap(ordered);
+}
+
+/*
+ * Clusters start where the FIFO cache misses the whole triangle, and are split further while their own ACMR stays
+ * within threshold of the original one; they are then sorted by how much they face away from the mesh centroid
+ */
+inline void MeshOptimizer::optimizeOverdraw(vector<Index>* indices, const vector<Point>& vertices, double threshold)
+{
+	size_t triangles = indices->size();
+	if (triangles == 0)
+		return;
+
+	vector<int> misses = cacheMisses(*indices, vertices.size(), CACHE_SIZE);
+	vector<size_t> clusters;
+	for (size_t t = 0; t < triangles; t++)
+		if (t == 0 || misses[t] == 3)
+			clusters.push_back(t);
+	clusters.push_back(triangles);
+
+	// each part is simulated from an empty cache, as it may end up drawn after any other one
+	vector<size_t> softClusters, insertion(vertices.size(), 0);
+	size_t time = 0;
+	for (size_t c = 0; c + 1 < clusters.size(); c++)
+	{
+		size_t first = clusters[c], last = clusters[c + 1], start = first;
+		double clusterMisses = 0.0;
+		for (size_t t = first; t < last; t++)
+			clusterMisses += misses[t];
+		double limit = threshold * clusterMisses / (last - first);
+
+		softClusters.push_back(first);
+		time += CACHE_SIZE + 1;
+		int partMisses = 0;
+		for (size_t t = first; t < last; t++)
+		{
+			GLuint corners[3] = { indices->at(t).i, indices->at(t).j, indices->at(t).k };
+			for (GLuint v : corners)
+			{
+				if (time - insertion[v] > (size_t)CACHE_SIZE)
+				{
+					insertion[v] = time++;
+					partMisses++;
+				}
+			}
+			if (t + 1 < last && t + 1 - start >= 8 && partMisses <= limit * (t + 1 - start))
+			{
+				softClusters.push_back(t + 1);
+				start = t + 1;
+				partMisses = 0;
+				time += CACHE_SIZE + 1;
+			}
+		}
+	}
+	softClusters.push_back(triangles);
+
+	dvec3 meshCentroid(0.0);
+	for (Point p : vertices)
+		meshCentroid += dvec3(p.x, p.y, p.z) / double(vertices.size());
+
+	vector<double> sortKeys(softClusters.size() - 1);
+	for (size_t c = 0; c + 1 < softClusters.size(); c++)
+	{
+		dvec3 centroid(0.0), normal(0.0);
+		double area = 0.0;
+		for (size_t t = softClusters[c]; t < softClusters[c + 1]; t++)
+		{
+			Point p0 = vertices[indices->at(t).i], p1 = vertices[indices->at(t).j], p2 = vertices[indices->at(t).k];
+			dvec3 a(p0.x, p0.y, p0.z), b(p1.x, p1.y, p1.z), d(p2.x, p2.y, p2.z);
+			dvec3 n = cross(b - a, d - a);
+			double l = length(n);
+			centroid += (a + b + d) * (l / 3.0);
+			normal += n;
+			area += l;
+		}
+		double l = length(normal);
+		sortKeys[c] = (area == 0.0 || l == 0.0) ? 0.0 : dot(centroid / area - meshCentroid, normal / l);
+	}
+
+	vector<size_t> order(sortKeys.size());
+	iota(order.begin(), order.end(), 0);
+	stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	vector<Index> sorted;
+	sorted.reserve(triangles);
+	for (size_t c : order)
+		sorted.insert(sorted.end(), indices->begin() + softClusters[c], indices->begin() + softClusters[c + 1]);
+	indices->swap(sorted);
+}
+
+/*
+ * Unreferenced vertices are kept, after the referenced ones
+ */
+inline vector<GLuint> MeshOptimizer::optimizeVertexFetch(vector<Point>* vertices, vector<Index>* indices)
+{
+	const GLuint UNUSED = 0xFFFFFFFF;
+	vector<GLuint> newIndex(vertices->size(), UNUSED), remap;
+	remap.reserve(vertices->size());
+	for (Index& t : *indices)
+	{
+		GLuint* corners[3] = { &t.i, &t.j, &t.k };
+		for (GLuint* v : corners)
+		{
+			if (newIndex[*v] == UNUSED)
+			{
+				newIndex[*v] = remap.size();
+				remap.push_back(*v);
+			}
+			*v = newIndex[*v];
+		}
+	}
+	for (GLuint v = 0; v < vertices->size(); v++)
+		if (newIndex[v] == UNUSED)
+			remap.push_back(v);
+
+	remapAttribute(vertices, remap);
+	return remap;
+}
+
+template <class T>
+inline void MeshOptimizer::remapAttribute(vector<T>* attribute, const vector<GLuint>& remap)
+{
+	if (attribute->size() != remap.size())
+		return;
+
+	vector<T> remapped;
+	remapped.reserve(remap.size());
+	for (GLuint v : remap)
+		remapped.push_back(attribute->at(v));
+	attribute->swap(remapped);
+}
\ No newline at end of file
@@ -1,73 +1,86 @@
-#pragma once
-#include "Utils.h"
-#include <stack>
-
-/*
- * Defines the OCS -> WCS Transformation
- */
-class Model
-{
-public:
-	static const mat4 IDENTITY;
-
-	Model();
-	Model* translate(double x, double y, double z);
-	Model* scale(double x, double y, double z);
-	Model* rotate(double angle, double x, double y, double z);
-	Model* pushMatrix();
-	Model* pullMatrix();
-	mat4 getMatrix();
-
-private:
-	stack<mat4> matrices;
-
-	Model* changeMatrix(mat4 newMatrix);
-};
-
-const mat4 Model::IDENTITY(1.0);
-
-Model::Model()
-{
-	matrices.push(IDENTITY);
-}
-
-inline Model* Model::translate(double x, double y, double z)
-{
-	return changeMatrix(glm::translate(getMatrix(), vec3(x, y, z)));
-}
-
-inline Model* Model::scale(double x, double y, double z)
-{
-	return changeMatrix(glm::scale(getMatrix(), vec3(x, y, z)));;
-}
-
-inline Model* Model::rotate(double angle, double x, double y, double z)
-{
-	return changeMatrix(glm::rotate(getMatrix(), float(radians(angle)), vec3(x, y, z)));;
-}
-
-inline Model* Model::pushMatrix()
-{
-	matrices.push(getMatrix());
-	return this;
-}
-
-inline Model* Model::pullMatrix()
-{
-	matrices.pop();
-	if (matrices.empty())
-		matrices.push(IDENTITY);
-	return this;
-}
-
-inline mat4 Model::getMatrix()
-{
-	return matrices.top();
-}
-
-inline Model* Model::changeMatrix(mat4 newMatrix)
-{
-	matrices.pop();
-	matrices.push(newMatrix);
-	return this;
-}
+#pragma once
+#include "Utils.h"
+
+/*
+ * Defines the OCS -> WCS Transformation
+ */
+class Model
+{
+public:
+	static const mat4 IDENTITY;
+	static const int CAPACITY = 32;
+
+	Model();
+	Model* translate(double x, double y, double z);
+	Model* scale(double x, double y, double z);
+	Model* rotate(double angle, double x, double y, double z);
+	Model* multiply(const mat4& matrix);
+	Model* pushMatrix();
+	Model* pullMatrix();
+	const mat4& getMatrix();
+
+private:
+	mat4 matrices[CAPACITY];
+	int top;
+};
+
+const mat4 Model::IDENTITY(1.0);
+
+Model::Model()
+{
+	top = 0;
+	matrices[top] = IDENTITY;
+}
+
+inline Model* Model::translate(double x, double y, double z)
+{
+	mat4& m = matrices[top];
+	m[3] = m[0] * float(x) + m[1] * float(y) + m[2] * float(z) + m[3];
+	return this;
+}
+
+inline Model* Model::scale(double x, double y, double z)
+{
+	mat4& m = matrices[top];
+	m[0] *= float(x);
+	m[1] *= float(y);
+	m[2] *= float(z);
+	return this;
+}
+
+inline Model* Model::rotate(double angle, double x, double y, double z)
+{
+	matrices[top] = glm::rotate(matrices[top], float(radians(angle)), vec3(x, y, z));
+	return this;
+}
+
+inline Model* Model::multiply(const mat4& matrix)
+{
+	matrices[top] = matrices[top] * matrix;
+	return this;
+}
+
+inline Model* Model::pushMatrix()
+{
+#ifndef NDEBUG
+	if (top + 1 == CAPACITY)
+		throw "model matrix stack overflow";
+#endif
+	matrices[top + 1] = matrices[top];
+	top++;
+	return this;
+}
+
+inline Model* Model::pullMatrix()
+{
+	if (top == 0)
+		matrices[top] = IDENTITY;
+	else
+		top--;
+	return this;
+}
+
+inline const mat4& Model::getMatrix()
+{
+	return matrices[top];
+}
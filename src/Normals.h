@@ -0,0 +1,267 @@
+#pragma once
+#include "Utils.h"
+#include "Parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NORMALS_SSE2
+#endif
+
+/*
+ * Utility Class to Generate Vertex Normals of Triangle Meshes
+ *
+ * Smooth normals sum the face normals around each vertex, weighted by the triangle area or by the angle at the vertex
+ * (faces are processed in parallel, then each vertex gathers its own corners); flat normals split every vertex shared
+ * by faces with different orientations. Face normals and corner weights are computed two triangles at a time with SSE2
+ * (the operations in the order of the scalar code, so both give the same normals), acos aside
+ */
+class Normals
+{
+public:
+	enum Weighting { AREA = 0, ANGLE = 1 };
+
+	static vector<Point> smooth(const vector<Point>& vertices, const vector<Index>& indices, Weighting weighting = ANGLE);
+	static vector<Point> flat(vector<Point>* vertices, vector<Index>* indices, vector<GLuint>* remap = NULL);
+	static Point normalize(Point p);
+
+private:
+	Normals();
+
+	static void corners(const vector<Point>& vertices, Index triangle, Weighting weighting, dvec3* out);
+	static dvec3 face(const vector<Point>& vertices, Index triangle);
+#ifdef NORMALS_SSE2
+	static void cornersSSE2(const vector<Point>& vertices, const Index* triangles, Weighting weighting, dvec3* out);
+	static void facesSSE2(const vector<Point>& vertices, const Index* triangles, dvec3* out);
+	static void crossSSE2(const vector<Point>& vertices, const Index* triangles, __m128d p[3][3], __m128d n[3], __m128d* l);
+#endif
+	static dvec3 toVec(Point p);
+	static Point toPoint(dvec3 v);
+};
+
+inline vector<Point> Normals::smooth(const vector<Point>& vertices, const vector<Index>& indices, Weighting weighting)
+{
+	vector<dvec3> corners(3 * indices.size());
+	Parallel::forRange(indices.size(), [&](size_t first, size_t last) {
+		size_t t = first;
+#ifdef NORMALS_SSE2
+		for (; t + 2 <= last; t += 2)
+			cornersSSE2(vertices, &indices[t], weighting, &corners[3 * t]);
+#endif
+		for (; t < last; t++)
+			Normals::corners(vertices, indices[t], weighting, &corners[3 * t]);
+	});
+
+	vector<size_t> offsets(vertices.size() + 1, 0), adjacency(corners.size());
+	for (Index t : indices)
+	{
+		offsets[t.i + 1]++;
+		offsets[t.j + 1]++;
+		offsets[t.k + 1]++;
+	}
+	for (size_t v = 0; v < vertices.size(); v++)
+		offsets[v + 1] += offsets[v];
+	vector<size_t> next(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < indices.size(); t++)
+	{
+		adjacency[next[indices[t].i]++] = 3 * t;
+		adjacency[next[indices[t].j]++] = 3 * t + 1;
+		adjacency[next[indices[t].k]++] = 3 * t + 2;
+	}
+
+	vector<Point> normals(vertices.size());
+	Parallel::forRange(vertices.size(), [&](size_t first, size_t last) {
+		for (size_t v = first; v < last; v++)
+		{
+			dvec3 n(0.0);
+			for (size_t c = offsets[v]; c < offsets[v + 1]; c++)
+				n += corners[adjacency[c]];
+			normals[v] = normalize(toPoint(n));
+		}
+	});
+	return normals;
+}
+
+/*
+ * Corners of a vertex whose faces agree on the normal keep sharing it; remap (if given) receives, for each new vertex,
+ * the old one it was copied from, so that other attributes can be split accordingly
+ */
+inline vector<Point> Normals::flat(vector<Point>* vertices, vector<Index>* indices, vector<GLuint>* remap)
+{
+	vector<dvec3> faces(indices->size());
+	Parallel::forRange(indices->size(), [&](size_t first, size_t last) {
+		size_t t = first;
+#ifdef NORMALS_SSE2
+		for (; t + 2 <= last; t += 2)
+			facesSSE2(*vertices, &indices->at(t), &faces[t]);
+#endif
+		for (; t < last; t++)
+			faces[t] = face(*vertices, indices->at(t));
+	});
+
+	vector<Point> splitVertices, normals;
+	vector<GLuint> origins;
+	vector<vector<GLuint>> copies(vertices->size());
+	splitVertices.reserve(vertices->size());
+	normals.reserve(vertices->size());
+	origins.reserve(vertices->size());
+	for (size_t t = 0; t < indices->size(); t++)
+	{
+		GLuint* corners[3] = { &indices->at(t).i, &indices->at(t).j, &indices->at(t).k };
+		for (GLuint* corner : corners)
+		{
+			GLuint vertex = *corner, copy = splitVertices.size();
+			for (GLuint c : copies[vertex])
+			{
+				if (dot(toVec(normals[c]), faces[t]) > 1.0 - 1e-9)
+				{
+					copy = c;
+					break;
+				}
+			}
+			if (copy == splitVertices.size())
+			{
+				splitVertices.push_back(vertices->at(vertex));
+				normals.push_back(toPoint(faces[t]));
+				origins.push_back(vertex);
+				copies[vertex].push_back(copy);
+			}
+			*corner = copy;
+		}
+	}
+
+	vertices->swap(splitVertices);
+	if (remap != NULL)
+		remap->swap(origins);
+	return normals;
+}
+
+inline Point Normals::normalize(Point p)
+{
+	double l = sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+	return l == 0.0 ? p : Point(p.x / l, p.y / l, p.z / l);
+}
+
+/*
+ * Face normal of the triangle weighted for each corner (by the area, or by the angle at the corner)
+ */
+inline void Normals::corners(const vector<Point>& vertices, Index triangle, Weighting weighting, dvec3* out)
+{
+	dvec3 p[3] = { toVec(vertices[triangle.i]), toVec(vertices[triangle.j]), toVec(vertices[triangle.k]) };
+	dvec3 n = cross(p[1] - p[0], p[2] - p[0]);
+	double l = length(n);
+	for (int k = 0; k < 3; k++)
+	{
+		if (weighting == AREA || l == 0.0)
+		{
+			out[k] = n;
+			continue;
+		}
+		dvec3 a = p[(k + 1) % 3] - p[k], b = p[(k + 2) % 3] - p[k];
+		double d = length(a) * length(b);
+		out[k] = d == 0.0 ? dvec3(0.0) : n * (acos(glm::clamp(dot(a, b) / d, -1.0, 1.0)) / l);
+	}
+}
+
+inline dvec3 Normals::face(const vector<Point>& vertices, Index triangle)
+{
+	dvec3 a = toVec(vertices[triangle.i]), b = toVec(vertices[triangle.j]), c = toVec(vertices[triangle.k]);
+	return toVec(normalize(toPoint(cross(b - a, c - a))));
+}
+
+#ifdef NORMALS_SSE2
+/*
+ * corners for two triangles, one per lane
+ */
+inline void Normals::cornersSSE2(const vector<Point>& vertices, const Index* triangles, Weighting weighting, dvec3* out)
+{
+	__m128d p[3][3], n[3], l;
+	crossSSE2(vertices, triangles, p, n, &l);
+	alignas(16) double nx[2], ny[2], nz[2], ls[2];
+	_mm_store_pd(nx, n[0]);
+	_mm_store_pd(ny, n[1]);
+	_mm_store_pd(nz, n[2]);
+	_mm_store_pd(ls, l);
+
+	for (int k = 0; k < 3; k++)
+	{
+		__m128d a[3], b[3];
+		for (int c = 0; c < 3; c++)
+		{
+			a[c] = _mm_sub_pd(p[(k + 1) % 3][c], p[k][c]);
+			b[c] = _mm_sub_pd(p[(k + 2) % 3][c], p[k][c]);
+		}
+		__m128d aa = _mm_add_pd(_mm_add_pd(_mm_mul_pd(a[0], a[0]), _mm_mul_pd(a[1], a[1])), _mm_mul_pd(a[2], a[2]));
+		__m128d bb = _mm_add_pd(_mm_add_pd(_mm_mul_pd(b[0], b[0]), _mm_mul_pd(b[1], b[1])), _mm_mul_pd(b[2], b[2]));
+		__m128d ab = _mm_add_pd(_mm_add_pd(_mm_mul_pd(a[0], b[0]), _mm_mul_pd(a[1], b[1])), _mm_mul_pd(a[2], b[2]));
+		__m128d d = _mm_mul_pd(_mm_sqrt_pd(aa), _mm_sqrt_pd(bb));
+		alignas(16) double ds[2], cosines[2];
+		_mm_store_pd(ds, d);
+		_mm_store_pd(cosines, _mm_div_pd(ab, d));
+
+		for (int lane = 0; lane < 2; lane++)
+		{
+			dvec3 normal(nx[lane], ny[lane], nz[lane]);
+			if (weighting == AREA || ls[lane] == 0.0)
+				out[3 * lane + k] = normal;
+			else
+				out[3 * lane + k] = ds[lane] == 0.0 ? dvec3(0.0) : normal * (acos(glm::clamp(cosines[lane], -1.0, 1.0)) / ls[lane]);
+		}
+	}
+}
+
+/*
+ * face for two triangles, one per lane
+ */
+inline void Normals::facesSSE2(const vector<Point>& vertices, const Index* triangles, dvec3* out)
+{
+	__m128d p[3][3], n[3], l;
+	crossSSE2(vertices, triangles, p, n, &l);
+	__m128d degenerate = _mm_cmpeq_pd(l, _mm_setzero_pd());
+	alignas(16) double result[3][2];
+	for (int c = 0; c < 3; c++)
+	{
+		__m128d unit = _mm_div_pd(n[c], l);
+		_mm_store_pd(result[c], _mm_or_pd(_mm_and_pd(degenerate, n[c]), _mm_andnot_pd(degenerate, unit)));
+	}
+	out[0] = dvec3(result[0][0], result[1][0], result[2][0]);
+	out[1] = dvec3(result[0][1], result[1][1], result[2][1]);
+}
+
+/*
+ * Corners p[corner][axis], normal n (cross of the edges from the first corner) and its length l of two triangles
+ */
+inline void Normals::crossSSE2(const vector<Point>& vertices, const Index* triangles, __m128d p[3][3], __m128d n[3], __m128d* l)
+{
+	GLuint first[3] = { triangles[0].i, triangles[0].j, triangles[0].k };
+	GLuint second[3] = { triangles[1].i, triangles[1].j, triangles[1].k };
+	for (int k = 0; k < 3; k++)
+	{
+		const Point& a = vertices[first[k]];
+		const Point& b = vertices[second[k]];
+		p[k][0] = _mm_set_pd(b.x, a.x);
+		p[k][1] = _mm_set_pd(b.y, a.y);
+		p[k][2] = _mm_set_pd(b.z, a.z);
+	}
+
+	__m128d e1[3], e2[3];
+	for (int c = 0; c < 3; c++)
+	{
+		e1[c] = _mm_sub_pd(p[1][c], p[0][c]);
+		e2[c] = _mm_sub_pd(p[2][c], p[0][c]);
+	}
+	n[0] = _mm_sub_pd(_mm_mul_pd(e1[1], e2[2]), _mm_mul_pd(e2[1], e1[2]));
+	n[1] = _mm_sub_pd(_mm_mul_pd(e1[2], e2[0]), _mm_mul_pd(e2[2], e1[0]));
+	n[2] = _mm_sub_pd(_mm_mul_pd(e1[0], e2[1]), _mm_mul_pd(e2[0], e1[1]));
+	*l = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(n[0], n[0]), _mm_mul_pd(n[1], n[1])), _mm_mul_pd(n[2], n[2])));
+}
+#endif
+
+inline dvec3 Normals::toVec(Point p)
+{
+	return dvec3(p.x, p.y, p.z);
+}
+
+inline Point Normals::toPoint(dvec3 v)
+{
+	return Point(v.x, v.y, v.z);
+}
\ No newline at end of file
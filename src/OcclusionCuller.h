@@ -0,0 +1,245 @@
+#pragma once
+#include "Utils.h"
+#include "Shape.h"
+#include "Shader.h"
+#include "Global.h"
+#include "Program.h"
+#include "Instances.h"
+#include <unordered_map>
+
+/*
+ * Occlusion Culling with Last Frame's Hardware Occlusion Queries
+ *
+ * Every object tested in a frame has its bounding box drawn, after the scene, against the finished depth buffer inside a
+ * GL_ANY_SAMPLES_PASSED query (colors and depth writes off, with the depth shader). Results are read the next frame with
+ * no stall: isVisible answers with the newest available one, and objects never tested or too close to the eye are
+ * visible. An object hidden in one frame is not drawn but still tested, so it reappears one frame after it is uncovered
+ */
+class OcclusionCuller
+{
+public:
+	static bool ENABLED;
+	static const unsigned long STALE_FRAMES;
+
+	OcclusionCuller();
+	~OcclusionCuller();
+
+	void beginFrame();
+	bool isVisible(const void* key);
+	void test(const void* key, Shape* shape, const mat4& transform);
+	void endFrame();
+	int getCulled();
+	int getTested();
+
+private:
+	struct Entry {
+		GLuint query = 0;
+		bool pending = false;
+		bool visible = true;
+		unsigned long frame = 0;
+	};
+
+	struct Box {
+		unsigned long version;
+		vec3 center;
+		vec3 extents;
+	};
+
+	struct Test {
+		Entry* entry;
+		mat4 model;
+	};
+
+	Shader* proxyShader;
+	GLuint cubeVAO, cubeVBO, cubeEBO;
+	unordered_map<const void*, Entry> entries;
+	unordered_map<Shape*, Box> boxes;
+	vector<Test> tests;
+	unsigned long frame;
+	int culled;
+
+	Box getBox(Shape* shape);
+};
+
+bool OcclusionCuller::ENABLED = false;
+const unsigned long OcclusionCuller::STALE_FRAMES = 120;
+
+inline OcclusionCuller::OcclusionCuller()
+{
+	frame = 0;
+	culled = 0;
+	proxyShader = (new Shader())->addShader(GL_VERTEX_SHADER, Shaders::DEPTH_VERTEX_FILENAME)
+		->addShader(GL_FRAGMENT_SHADER, Shaders::DEPTH_FRAGMENT_FILENAME)->updateProgram()
+		->setVariableLocation(Shaders::VIEW_VARIABLE)
+		->setVariableLocation(Shaders::PROJECTION_VARIABLE);
+	glUseProgram(Program::getShader()->getProgramId());
+
+	GLfloat corners[] = { -1, -1, -1, 1, -1, -1, 1, 1, -1, -1, 1, -1, -1, -1, 1, 1, -1, 1, 1, 1, 1, -1, 1, 1 };
+	GLubyte faces[] = { 0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4, 3, 6, 2, 3, 7, 6, 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5 };
+	glGenVertexArrays(1, &cubeVAO);
+	glBindVertexArray(cubeVAO);
+	glGenBuffers(1, &cubeVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glGenBuffers(1, &cubeEBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+inline OcclusionCuller::~OcclusionCuller()
+{
+	for (pair<const void* const, Entry>& entry : entries)
+		glDeleteQueries(1, &entry.second.query);
+	glDeleteVertexArrays(1, &cubeVAO);
+	glDeleteBuffers(1, &cubeVBO);
+	glDeleteBuffers(1, &cubeEBO);
+	delete proxyShader;
+}
+
+/*
+ * Reads the results that became available and forgets the objects not tested for STALE_FRAMES (deleted ones, mostly)
+ */
+inline void OcclusionCuller::beginFrame()
+{
+	frame++;
+	culled = 0;
+	tests.clear();
+	for (unordered_map<const void*, Entry>::iterator entry = entries.begin(); entry != entries.end();)
+	{
+		Entry& e = entry->second;
+		if (e.pending)
+		{
+			GLint available = 0;
+			glGetQueryObjectiv(e.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+			{
+				GLuint passed = 0;
+				glGetQueryObjectuiv(e.query, GL_QUERY_RESULT, &passed);
+				e.visible = passed != 0;
+				e.pending = false;
+			}
+		}
+		if (!e.pending && frame - e.frame > STALE_FRAMES)
+		{
+			glDeleteQueries(1, &e.query);
+			entry = entries.erase(entry);
+		}
+		else
+			entry++;
+	}
+}
+
+inline bool OcclusionCuller::isVisible(const void* key)
+{
+	unordered_map<const void*, Entry>::iterator entry = entries.find(key);
+	bool visible = entry == entries.end() || entry->second.visible;
+	if (!visible)
+		culled++;
+	return visible;
+}
+
+/*
+ * Schedules the box of the shape (in local coordinates, under the transform) for the query of this frame;
+ * a box whose bounding sphere contains the eye, or may be clipped by the near plane, is visible without a query
+ */
+inline void OcclusionCuller::test(const void* key, Shape* shape, const mat4& transform)
+{
+	if (shape == NULL)
+		return;
+
+	Entry& entry = entries[key];
+	entry.frame = frame;
+	Box box = getBox(shape);
+	// a small margin keeps the faces of box-shaped bodies from failing the depth test against themselves
+	mat4 model = transform * translate(box.center) * scale(box.extents * 1.01f + vec3(0.001f));
+
+	// the unit cube spans the columns of the model matrix, so its corners are no farther than their lengths added
+	vec3 center = vec3(model[3].x, model[3].y, model[3].z);
+	float radius = length(vec3(model[0].x, model[0].y, model[0].z)) + length(vec3(model[1].x, model[1].y, model[1].z)) + length(vec3(model[2].x, model[2].y, model[2].z));
+	if (distance(Program::getView()->getPosition(), center) <= radius + Program::getProjection()->getPlanes().first)
+	{
+		entry.visible = true;
+		return;
+	}
+	if (!entry.pending)
+		tests.push_back({ &entry, model });
+}
+
+/*
+ * Draws the boxes scheduled in this frame, each in its own query; call it after the scene, with its depth buffer
+ */
+inline void OcclusionCuller::endFrame()
+{
+	if (tests.empty())
+		return;
+
+	glUseProgram(proxyShader->getProgramId());
+	proxyShader->setUniformMat4(Shaders::VIEW_VARIABLE, Program::getView()->getMatrix())
+		->setUniformMat4(Shaders::PROJECTION_VARIABLE, Program::getProjection()->getMatrix());
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_LEQUAL);
+	glBindVertexArray(cubeVAO);
+	for (Test& test : tests)
+	{
+		if (test.entry->query == 0)
+			glGenQueries(1, &test.entry->query);
+		Instances::push(test.model);
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, test.entry->query);
+		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, 0);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		test.entry->pending = true;
+	}
+	glBindVertexArray(0);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glUseProgram(Program::getShader()->getProgramId());
+}
+
+/*
+ * Objects skipped in this frame
+ */
+inline int OcclusionCuller::getCulled()
+{
+	return culled;
+}
+
+/*
+ * Queries issued in this frame
+ */
+inline int OcclusionCuller::getTested()
+{
+	return tests.size();
+}
+
+/*
+ * Axis-aligned box of the vertices (of all levels), or the cube around the bounding sphere once the mirror is released;
+ * cached until the shape is uploaded again
+ */
+inline OcclusionCuller::Box OcclusionCuller::getBox(Shape* shape)
+{
+	unordered_map<Shape*, Box>::iterator cached = boxes.find(shape);
+	if (cached != boxes.end() && cached->second.version == shape->getVersion())
+		return cached->second;
+
+	Box box = { shape->getVersion(), vec3(0.0f), vec3(float(shape->getRadius())) };
+	if (shape->hasMirror() && !shape->getVertices()->empty())
+	{
+		Point first = shape->getVertices()->front();
+		dvec3 low(first.x, first.y, first.z), high = low;
+		for (Point v : *shape->getVertices())
+		{
+			low = dvec3(std::min(low.x, v.x), std::min(low.y, v.y), std::min(low.z, v.z));
+			high = dvec3(std::max(high.x, v.x), std::max(high.y, v.y), std::max(high.z, v.z));
+		}
+		box.center = vec3(float(low.x + high.x), float(low.y + high.y), float(low.z + high.z)) * 0.5f;
+		box.extents = vec3(float(high.x - low.x), float(high.y - low.y), float(high.z - low.z)) * 0.5f;
+	}
+	boxes[shape] = box;
+	return box;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "Utils.h"
+#include <thread>
+#include <atomic>
+
+/*
+ * Utility Class to Split a Loop over the Hardware Threads
+ */
+class Parallel
+{
+public:
+	static const size_t MIN_GRAIN;
+
+	static unsigned int getThreads();
+	static void forRange(size_t count, function<void(size_t first, size_t last)> body, size_t grain = MIN_GRAIN);
+	static void forEach(size_t count, function<void(size_t index)> body);
+
+private:
+	Parallel();
+};
+
+const size_t Parallel::MIN_GRAIN = 4096;
+
+inline unsigned int Parallel::getThreads()
+{
+	return std::max(1u, thread::hardware_concurrency());
+}
+
+/*
+ * Calls body on contiguous ranges covering [0, count), running them on the calling thread when too few to be worth a split
+ */
+inline void Parallel::forRange(size_t count, function<void(size_t first, size_t last)> body, size_t grain)
+{
+	size_t chunks = std::min<size_t>(getThreads(), (count + grain - 1) / std::max<size_t>(grain, 1));
+	if (chunks <= 1)
+	{
+		body(0, count);
+		return;
+	}
+
+	vector<thread> workers;
+	size_t size = (count + chunks - 1) / chunks;
+	for (size_t first = size; first < count; first += size)
+		workers.push_back(thread(body, first, std::min(count, first + size)));
+	body(0, size);
+	for (thread& worker : workers)
+		worker.join();
+}
+
+/*
+ * Calls body on every index in [0, count), each thread taking the next one as soon as it is done, for items of uneven cost
+ */
+inline void Parallel::forEach(size_t count, function<void(size_t index)> body)
+{
+	atomic<size_t> next(0);
+	forRange(std::min<size_t>(getThreads(), count), [&](size_t, size_t) {
+		for (size_t index = next++; index < count; index = next++)
+			body(index);
+	}, 1);
+}
\ No newline at end of file
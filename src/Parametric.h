@@ -0,0 +1,136 @@
+#pragma once
+#include "Utils.h"
+#include "Normals.h"
+
+/*
+ * Grid Mesher for Parametric Surfaces
+ *
+ * A Surface is a functor mapping (u, v) in [0, 1] x [0, 1] to a Point, with a normal(u, v) method returning the
+ * (not necessarily unit) outward normal there, and declaring its topology at compile time:
+ *   WRAP_U, WRAP_V       the surface is closed along u (v), so the last column (row) is welded to the first one
+ *   POLE_START, POLE_END the whole v = 0 (v = 1) row collapses into a single vertex
+ * Vertices and indices are counted exactly beforehand, with no out-of-range or degenerate triangle
+ */
+class Parametric
+{
+public:
+	static const GLuint RESTART_INDEX;
+
+	template <class S> static unsigned int countVertices(unsigned int stacks, unsigned int slices);
+	template <class S> static unsigned int countTriangles(unsigned int stacks, unsigned int slices);
+	template <class S> static unsigned int countStripIndices(unsigned int stacks, unsigned int slices);
+	template <class S> static void generate(const S& surface, unsigned int stacks, unsigned int slices, vector<Point>* vertices, vector<Point>* normals, vector<Index>* triangles, vector<GLuint>* strips = NULL);
+
+private:
+	Parametric();
+
+	template <class S> static GLuint vertexIndex(unsigned int row, unsigned int column, unsigned int stacks, unsigned int slices);
+};
+
+const GLuint Parametric::RESTART_INDEX = 0xFFFFFFFF;
+
+template <class S>
+inline unsigned int Parametric::countVertices(unsigned int stacks, unsigned int slices)
+{
+	unsigned int rows = (S::WRAP_V ? stacks : stacks + 1) - S::POLE_START - S::POLE_END;
+	unsigned int columns = S::WRAP_U ? slices : slices + 1;
+	return rows * columns + S::POLE_START + S::POLE_END;
+}
+
+template <class S>
+inline unsigned int Parametric::countTriangles(unsigned int stacks, unsigned int slices)
+{
+	return 2 * stacks * slices - (S::POLE_START + S::POLE_END) * slices;
+}
+
+/*
+ * One strip (2 indices per column plus the restart) per band, and one 3-indices strip per pole triangle
+ */
+template <class S>
+inline unsigned int Parametric::countStripIndices(unsigned int stacks, unsigned int slices)
+{
+	unsigned int poles = S::POLE_START + S::POLE_END;
+	return (stacks - poles) * (2 * (slices + 1) + 1) + poles * slices * 4;
+}
+
+template <class S>
+inline GLuint Parametric::vertexIndex(unsigned int row, unsigned int column, unsigned int stacks, unsigned int slices)
+{
+	unsigned int columns = S::WRAP_U ? slices : slices + 1;
+	if (S::WRAP_V && row == stacks)
+		row = 0;
+	if (S::WRAP_U && column == slices)
+		column = 0;
+
+	if (S::POLE_START && row == 0)
+		return 0;
+	if (S::POLE_END && row == stacks)
+		return countVertices<S>(stacks, slices) - 1;
+	return S::POLE_START + (row - S::POLE_START) * columns + column;
+}
+
+/*
+ * Each quad A = (r, c), B = (r, c + 1), C = (r + 1, c + 1), D = (r + 1, c) is split into DAC and CAB,
+ * the same triangles (and winding) a strip D0 A0 D1 A1 ... gives, of which only the non-degenerate one is kept next to a pole
+ */
+template <class S>
+inline void Parametric::generate(const S& surface, unsigned int stacks, unsigned int slices, vector<Point>* vertices, vector<Point>* normals, vector<Index>* triangles, vector<GLuint>* strips)
+{
+	static_assert(!(S::WRAP_V && (S::POLE_START || S::POLE_END)), "a surface closed along v has no poles");
+	if (stacks < (S::POLE_START && S::POLE_END ? 2u : 1u) || slices < (S::WRAP_U ? 3u : 1u))
+		throw "too few segments for the surface";
+
+	vertices->clear();
+	vertices->reserve(countVertices<S>(stacks, slices));
+	normals->clear();
+	normals->reserve(countVertices<S>(stacks, slices));
+	unsigned int columns = S::WRAP_U ? slices : slices + 1;
+	unsigned int rows = S::WRAP_V ? stacks : stacks + 1;
+	for (unsigned int r = 0; r < rows; r++)
+	{
+		bool pole = (S::POLE_START && r == 0) || (S::POLE_END && r == stacks);
+		for (unsigned int c = 0; c < (pole ? 1 : columns); c++)
+		{
+			vertices->push_back(surface(double(c) / slices, double(r) / stacks));
+			normals->push_back(Normals::normalize(surface.normal(double(c) / slices, double(r) / stacks)));
+		}
+	}
+
+	triangles->clear();
+	triangles->reserve(countTriangles<S>(stacks, slices));
+	for (unsigned int r = 0; r < stacks; r++)
+	{
+		for (unsigned int c = 0; c < slices; c++)
+		{
+			GLuint a = vertexIndex<S>(r, c, stacks, slices), b = vertexIndex<S>(r, c + 1, stacks, slices);
+			GLuint cc = vertexIndex<S>(r + 1, c + 1, stacks, slices), d = vertexIndex<S>(r + 1, c, stacks, slices);
+			if (!(S::POLE_END && r == stacks - 1))
+				triangles->push_back({ d, a, cc });
+			if (!(S::POLE_START && r == 0))
+				triangles->push_back({ cc, a, b });
+		}
+	}
+
+	if (strips == NULL)
+		return;
+	strips->clear();
+	strips->reserve(countStripIndices<S>(stacks, slices));
+	for (unsigned int r = 0; r < stacks; r++)
+	{
+		bool startPole = S::POLE_START && r == 0, endPole = S::POLE_END && r == stacks - 1;
+		if (startPole || endPole)
+		{
+			size_t first = startPole ? 0 : triangles->size() - slices;
+			for (size_t t = first; t < first + slices; t++)
+				strips->insert(strips->end(), { triangles->at(t).i, triangles->at(t).j, triangles->at(t).k, RESTART_INDEX });
+			continue;
+		}
+
+		for (unsigned int c = 0; c <= slices; c++)
+		{
+			strips->push_back(vertexIndex<S>(r + 1, c, stacks, slices));
+			strips->push_back(vertexIndex<S>(r, c, stacks, slices));
+		}
+		strips->push_back(RESTART_INDEX);
+	}
+}
\ No newline at end of file
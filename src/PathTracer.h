@@ -0,0 +1,925 @@
+#pragma once
+#include "Utils.h"
+#include "Shape.h"
+#include "Global.h"
+#include "Program.h"
+#include "Image.h"
+#include "Parallel.h"
+#include "RigidBody.h"
+#include <map>
+#include <atomic>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PATHTRACER_SSE2
+#endif
+
+/*
+ * Offline Multithreaded CPU Path Tracer over a Two-Level BVH
+ *
+ * Each shape (at a sub-mesh) gets a binned SAH BVH of its triangles in local coordinates, built once and shared by every
+ * instance until the shape is uploaded again; build adds a top level BVH over the instance boxes. Rays travel in packets
+ * of 4 (a 2x2 pixel block), tested 4 at a time against boxes and triangles (SSE2, with a scalar fallback) and moved into
+ * the local space of each instance they reach. Every sample pass traces one path per pixel, the tiles going to the
+ * hardware threads: at each bounce the lights are sampled with shadow rays (lit with the terms of the shaders) and
+ * the path goes on along a diffuse or a Phong lobe; escaping paths gather the ambient light. Random numbers depend on
+ * the pixel and pass only, so images do not depend on the number of threads
+ */
+class PathTracer
+{
+public:
+	static const int TILE_SIZE;
+	static const int MAX_BOUNCES;
+	static const float ALBEDO;
+
+	PathTracer(int width, int height);
+	~PathTracer();
+
+	PathTracer* setLights(const vector<PointLight>& lights);
+	PathTracer* setVertexColors(bool vertexColors);
+	PathTracer* clear();
+	PathTracer* add(const Material* material, Shape* shape, int subMesh, const mat4& transform);
+	PathTracer* add(RigidBody* body);
+	PathTracer* build();
+	PathTracer* sample();
+	PathTracer* capture(Image* image);
+	int getSamples();
+	uint64_t getRays();
+
+private:
+	static const int LEAF_SIZE;
+	static const int MAX_LEAF;
+	static const int BINS = 16;
+	static const int MAX_DEPTH = 64;
+	static const float EPSILON;
+
+	struct Bounds {
+		vec3 low = vec3(numeric_limits<float>::max());
+		vec3 high = vec3(-numeric_limits<float>::max());
+		void grow(vec3 p) {
+			low = glm::min(low, p);
+			high = glm::max(high, p);
+		}
+		void grow(const Bounds& b) {
+			low = glm::min(low, b.low);
+			high = glm::max(high, b.high);
+		}
+		float getArea() const {
+			vec3 e = high - low;
+			return e.x < 0.0f ? 0.0f : e.x * e.y + e.y * e.z + e.z * e.x;
+		}
+	};
+
+	struct Node {
+		float low[3], high[3];
+		uint32_t offset;
+		uint32_t count;
+		uint32_t axis;
+	};
+
+	struct Triangle {
+		float v0[3], e1[3], e2[3];
+		uint32_t index;
+	};
+
+	struct Mesh {
+		Shape* shape;
+		int subMesh;
+		unsigned long version;
+		vector<Node> nodes;
+		vector<Triangle> triangles;
+	};
+
+	struct Instance {
+		Mesh* mesh;
+		mat4 model, inverse;
+		mat3 normalMatrix;
+		vec3 diffuse, specular;
+		float shininess;
+		Bounds bounds;
+	};
+
+	struct Packet {
+		alignas(16) float o[3][4];
+		alignas(16) float d[3][4];
+		alignas(16) float inv[3][4];
+		alignas(16) float t[4];
+		float u[4], v[4];
+		int instance[4], triangle[4];
+		int mask;
+		int occluded;
+		void setRay(int lane, vec3 origin, vec3 direction, float distance) {
+			for (int a = 0; a < 3; a++)
+			{
+				o[a][lane] = origin[a];
+				d[a][lane] = direction[a];
+				inv[a][lane] = 1.0f / direction[a];
+			}
+			t[lane] = distance;
+			instance[lane] = -1;
+		}
+	};
+
+	struct Surface {
+		vec3 position, normal, view, base;
+		vec3 diffuse, specular;
+		float shininess;
+	};
+
+	struct Random {
+		uint32_t state;
+		void seed(uint32_t pixel, uint32_t pass) {
+			state = hash(pixel ^ hash(pass + 0x9E3779B9u));
+		}
+		float next() {
+			state = state * 747796405u + 2891336453u;
+			uint32_t word = ((state >> ((state >> 28) + 4u)) ^ state) * 277803737u;
+			return float(((word >> 22) ^ word) >> 8) * (1.0f / 16777216.0f);
+		}
+	};
+
+	int width, height, tilesX, tilesY;
+	int samples;
+	atomic<uint64_t> rays;
+	vector<PointLight> lights;
+	bool vertexColors;
+	vec3 eye, forward, right, up;
+	float tanX, tanY;
+	vector<Instance> instances;
+	vector<Node> topNodes;
+	map<pair<Shape*, int>, Mesh*> meshes;
+	vector<float> accumulation;
+
+	void trace(int x, int y, int x1, int y1, uint64_t* traced);
+	Surface getSurface(const Packet& packet, int lane);
+	void traverse(Packet* packet, bool any);
+	void traverse(const Instance& instance, int id, Packet* packet, bool any);
+	int intersect(const Node& node, const Packet& packet);
+	void intersect(const Triangle& triangle, uint32_t index, int instance, Packet* packet, bool any);
+	void pushChildren(const Node& node, uint32_t index, const Packet& packet, uint32_t* stack, int* top);
+	void buildMesh(Mesh* mesh);
+	static void build(const vector<Bounds>& boxes, vector<uint32_t>* order, vector<Node>* nodes);
+	static uint32_t split(const vector<Bounds>& boxes, vector<uint32_t>* order, uint32_t first, uint32_t count, int depth, vector<Node>* nodes);
+	static uint32_t hash(uint32_t x);
+};
+
+const int PathTracer::TILE_SIZE = 32;
+const int PathTracer::MAX_BOUNCES = 4;
+const float PathTracer::ALBEDO = 0.8f;
+const int PathTracer::LEAF_SIZE = 4;
+const int PathTracer::MAX_LEAF = 16;
+const float PathTracer::EPSILON = 1e-4f;
+
+inline PathTracer::PathTracer(int width, int height)
+{
+	this->width = std::max(width, 1);
+	this->height = std::max(height, 1);
+	tilesX = (this->width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (this->height + TILE_SIZE - 1) / TILE_SIZE;
+	samples = 0;
+	rays = 0;
+	vertexColors = false;
+	tanX = tanY = 0.0f;
+	accumulation.assign(size_t(this->width) * this->height * 3, 0.0f);
+}
+
+inline PathTracer::~PathTracer()
+{
+	for (pair<const pair<Shape*, int>, Mesh*>& mesh : meshes)
+		delete mesh.second;
+}
+
+/*
+ * Point and spot lights, fading as in the CLUSTERED shaders; those with no radius do not fade (like the light of the
+ * vertex shader, at the eye)
+ */
+inline PathTracer* PathTracer::setLights(const vector<PointLight>& lights)
+{
+	this->lights = lights;
+	return this;
+}
+
+inline PathTracer* PathTracer::setVertexColors(bool vertexColors)
+{
+	this->vertexColors = vertexColors;
+	return this;
+}
+
+inline PathTracer* PathTracer::clear()
+{
+	instances.clear();
+	return this;
+}
+
+/*
+ * Queues an instance of the sub-mesh (all of them when negative) of the shape, with the current model matrix multiplied
+ * by the given one; shapes without their CPU mirror are skipped
+ */
+inline PathTracer* PathTracer::add(const Material* material, Shape* shape, int subMesh, const mat4& transform)
+{
+	if (shape == NULL || !shape->hasMirror() || shape->getIndices()->empty())
+		return this;
+
+	Mesh*& mesh = meshes[{ shape, subMesh }];
+	if (mesh == NULL)
+		mesh = new Mesh{ shape, subMesh, 0, {}, {} };
+
+	Instance instance;
+	instance.mesh = mesh;
+	instance.model = Program::getModel()->getMatrix() * transform;
+	mat3 linear = inverse(mat3(instance.model));
+	vec3 translation = linear * vec3(instance.model[3].x, instance.model[3].y, instance.model[3].z);
+	instance.inverse = mat4(linear);
+	instance.inverse[3] = vec4(-translation.x, -translation.y, -translation.z, 1.0f);
+	instance.normalMatrix = transpose(linear);
+	instance.diffuse = World::DEFAULT_LIGHT.diffuse * material->diffuse;
+	instance.specular = World::DEFAULT_LIGHT.specular * material->specular;
+	instance.shininess = material->shininess;
+	instances.push_back(instance);
+	return this;
+}
+
+/*
+ * Queues the shape of the body at its finest level of detail, with the body material
+ */
+inline PathTracer* PathTracer::add(RigidBody* body)
+{
+	if (body->getShape() == NULL)
+		return this;
+
+	const Material* m = body->isSelected() ? &World::SELECTED_MATERIAL : &World::DEFAULT_MATERIAL;
+	return add(m, body->getShape(), body->getShape()->getLevels() > 1 ? 0 : -1, body->getTransform());
+}
+
+/*
+ * Builds the BVHs of the shapes that are new or were uploaded again (in parallel, one shape per thread), then the top
+ * level one over the queued instances, and starts a new image from the current view and projection
+ */
+inline PathTracer* PathTracer::build()
+{
+	vector<Mesh*> stale;
+	for (Instance& instance : instances)
+	{
+		Mesh* mesh = instance.mesh;
+		if (mesh->version != mesh->shape->getVersion() || mesh->nodes.empty())
+		{
+			mesh->version = mesh->shape->getVersion();
+			stale.push_back(mesh);
+		}
+	}
+	std::sort(stale.begin(), stale.end());
+	stale.erase(std::unique(stale.begin(), stale.end()), stale.end());
+	Parallel::forEach(stale.size(), [&](size_t m) { buildMesh(stale[m]); });
+
+	vector<Instance> queued;
+	queued.swap(instances);
+	vector<Bounds> boxes;
+	for (Instance& instance : queued)
+	{
+		if (instance.mesh->triangles.empty())
+			continue;
+		const Node& root = instance.mesh->nodes[0];
+		for (int c = 0; c < 8; c++)
+		{
+			vec4 corner = instance.model * vec4(c & 1 ? root.high[0] : root.low[0], c & 2 ? root.high[1] : root.low[1], c & 4 ? root.high[2] : root.low[2], 1.0f);
+			instance.bounds.grow(vec3(corner.x, corner.y, corner.z));
+		}
+		instances.push_back(instance);
+		boxes.push_back(instance.bounds);
+	}
+
+	vector<uint32_t> order;
+	build(boxes, &order, &topNodes);
+	queued.clear();
+	for (uint32_t i : order)
+		queued.push_back(instances[i]);
+	instances.swap(queued);
+
+	eye = Program::getView()->getPosition();
+	forward = normalize(Program::getView()->getCenter() - eye);
+	right = normalize(cross(forward, Program::getView()->getNormal()));
+	up = cross(right, forward);
+	tanY = float(tan(Program::getProjection()->getFieldOfView() / 2.0));
+	tanX = tanY * float(Program::getProjection()->getAspectRatio());
+
+	samples = 0;
+	rays = 0;
+	std::fill(accumulation.begin(), accumulation.end(), 0.0f);
+	return this;
+}
+
+/*
+ * Adds one sample per pixel, tracing the tiles on every hardware thread
+ */
+inline PathTracer* PathTracer::sample()
+{
+	Parallel::forEach(size_t(tilesX) * tilesY, [&](size_t tile) {
+		int x = int(tile % tilesX) * TILE_SIZE, y = int(tile / tilesX) * TILE_SIZE;
+		uint64_t traced = 0;
+		trace(x, y, std::min(x + TILE_SIZE, width), std::min(y + TILE_SIZE, height), &traced);
+		rays += traced;
+	});
+	samples++;
+	return this;
+}
+
+/*
+ * Writes the average of the samples so far, clamped like the framebuffer, flipped to the top-down rows of Image
+ */
+inline PathTracer* PathTracer::capture(Image* image)
+{
+	if (image->getWidth() != width || image->getHeight() != height)
+		throw "image and path tracer sizes differ";
+	float scale = 255.0f / std::max(samples, 1);
+	for (int y = 0; y < height; y++)
+	{
+		const float* row = accumulation.data() + size_t(y) * width * 3;
+		unsigned char* out = image->getPixels() + size_t(height - 1 - y) * width * 3;
+		for (int i = 0; i < width * 3; i++)
+			out[i] = (unsigned char)(glm::clamp(row[i] * scale, 0.0f, 255.0f) + 0.5f);
+	}
+	return this;
+}
+
+inline int PathTracer::getSamples()
+{
+	return samples;
+}
+
+/*
+ * Rays traced since build, shadow rays included
+ */
+inline uint64_t PathTracer::getRays()
+{
+	return rays;
+}
+
+/*
+ * Traces one path per pixel of the region, in 2x2 packets
+ */
+inline void PathTracer::trace(int x0, int y0, int x1, int y1, uint64_t* traced)
+{
+	const vec3 sky = World::DEFAULT_LIGHT.ambient;
+	for (int y = y0; y < y1; y += 2)
+		for (int x = x0; x < x1; x += 2)
+		{
+			Packet packet;
+			Random random[4];
+			vec3 throughput[4], radiance[4];
+			int alive = 0;
+			for (int k = 0; k < 4; k++)
+			{
+				int px = x + (k & 1), py = y + (k >> 1);
+				throughput[k] = vec3(1.0f);
+				radiance[k] = vec3(0.0f);
+				if (px >= x1 || py >= y1)
+					continue;
+				alive |= 1 << k;
+				random[k].seed(uint32_t(py * width + px), uint32_t(samples));
+				float sx = (px + random[k].next()) / width * 2.0f - 1.0f;
+				float sy = (py + random[k].next()) / height * 2.0f - 1.0f;
+				packet.setRay(k, eye, normalize(forward + right * (sx * tanX) + up * (sy * tanY)), numeric_limits<float>::max());
+			}
+
+			for (int bounce = 0; bounce <= MAX_BOUNCES && alive != 0; bounce++)
+			{
+				packet.mask = alive;
+				packet.occluded = 0;
+				for (int k = 0; k < 4; k++)
+					packet.instance[k] = -1;
+				traverse(&packet, false);
+
+				Surface surfaces[4];
+				for (int k = 0; k < 4; k++)
+				{
+					if (!(alive >> k & 1))
+						continue;
+					(*traced)++;
+					if (packet.instance[k] < 0)
+					{
+						// the ambient term of the shaders is light coming from everywhere; the background stays black
+						if (bounce > 0)
+							radiance[k] += throughput[k] * sky;
+						alive &= ~(1 << k);
+						continue;
+					}
+					surfaces[k] = getSurface(packet, k);
+				}
+
+				// direct light, with the diffuse and specular terms of the shaders
+				for (const PointLight& light : lights)
+				{
+					Packet shadow;
+					vec3 contribution[4];
+					int lit = 0;
+					for (int k = 0; k < 4; k++)
+					{
+						if (!(alive >> k & 1))
+							continue;
+						const Surface& s = surfaces[k];
+						vec3 toLight = light.position - s.position;
+						float distance = length(toLight);
+						if (distance <= 0.0f)
+							continue;
+						vec3 L = toLight / distance;
+						float attenuation = 1.0f;
+						if (light.radius > 0.0f)
+						{
+							float falloff = glm::clamp(1.0f - (distance / light.radius) * (distance / light.radius), 0.0f, 1.0f);
+							attenuation = falloff * falloff;
+						}
+						if (light.cutoff > -1.0f)
+							attenuation *= smoothstep(light.cutoff, mix(light.cutoff, 1.0f, 0.1f), dot(-L, normalize(light.direction)));
+						float diffuse = dot(L, s.normal);
+						if (attenuation <= 0.0f || diffuse <= 0.0f)
+							continue;
+						vec3 R = 2.0f * diffuse * s.normal - L;
+						float specular = pow(std::max(dot(R, s.view), 0.0f), s.shininess);
+						contribution[k] = throughput[k] * s.base * (s.diffuse * diffuse + s.specular * specular) * light.color * attenuation;
+						shadow.setRay(k, s.position, L, distance * (1.0f - EPSILON));
+						lit |= 1 << k;
+					}
+					if (lit == 0)
+						continue;
+					shadow.mask = lit;
+					shadow.occluded = 0;
+					traverse(&shadow, true);
+					for (int k = 0; k < 4; k++)
+						if (lit >> k & 1)
+						{
+							(*traced)++;
+							if (!(shadow.occluded >> k & 1))
+								radiance[k] += contribution[k];
+						}
+				}
+
+				// indirect light, along the specular lobe as often as the specular color is bright, along the diffuse one otherwise
+				for (int k = 0; k < 4; k++)
+				{
+					if (!(alive >> k & 1))
+						continue;
+					const Surface& s = surfaces[k];
+					float glossy = glm::clamp((s.specular.x + s.specular.y + s.specular.z) / 3.0f, 0.0f, 1.0f);
+					vec3 axis, weight;
+					float exponent;
+					if (random[k].next() < glossy)
+					{
+						axis = 2.0f * dot(s.view, s.normal) * s.normal - s.view;
+						weight = s.base * s.specular / glossy;
+						exponent = s.shininess;
+					}
+					else
+					{
+						axis = s.normal;
+						weight = s.base * s.diffuse * ALBEDO / (1.0f - glossy);
+						exponent = 1.0f;
+					}
+
+					// cosine power lobe around the axis
+					float cosine = pow(random[k].next(), 1.0f / (exponent + 1.0f));
+					float sine = sqrt(std::max(0.0f, 1.0f - cosine * cosine));
+					float phi = 2.0f * glm::pi<float>() * random[k].next();
+					vec3 tangent = normalize(cross(std::abs(axis.x) > 0.5f ? vec3(0.0f, 1.0f, 0.0f) : vec3(1.0f, 0.0f, 0.0f), axis));
+					vec3 direction = normalize(tangent * (sine * float(cos(phi))) + cross(axis, tangent) * (sine * float(sin(phi))) + axis * cosine);
+					throughput[k] *= weight;
+
+					float survival = std::min(std::max(throughput[k].x, std::max(throughput[k].y, throughput[k].z)), 0.95f);
+					if (dot(direction, s.normal) <= 0.0f || (bounce >= 2 && random[k].next() >= survival))
+					{
+						alive &= ~(1 << k);
+						continue;
+					}
+					if (bounce >= 2)
+						throughput[k] /= survival;
+					packet.setRay(k, s.position, direction, numeric_limits<float>::max());
+				}
+			}
+
+			for (int k = 0; k < 4; k++)
+			{
+				int px = x + (k & 1), py = y + (k >> 1);
+				if (px >= x1 || py >= y1)
+					continue;
+				float* pixel = accumulation.data() + (size_t(py) * width + px) * 3;
+				pixel[0] += radiance[k].x;
+				pixel[1] += radiance[k].y;
+				pixel[2] += radiance[k].z;
+			}
+		}
+}
+
+/*
+ * Hit point (moved off the surface), normal facing the ray, view direction and material of a lane that hit
+ */
+inline PathTracer::Surface PathTracer::getSurface(const Packet& packet, int lane)
+{
+	const Instance& instance = instances[packet.instance[lane]];
+	const Triangle& triangle = instance.mesh->triangles[packet.triangle[lane]];
+	Shape* shape = instance.mesh->shape;
+	Index index = (*shape->getIndices())[triangle.index];
+	float u = packet.u[lane], v = packet.v[lane], w = 1.0f - u - v;
+
+	vec3 direction(packet.d[0][lane], packet.d[1][lane], packet.d[2][lane]);
+	vec3 geometric = instance.normalMatrix * cross(vec3(triangle.e1[0], triangle.e1[1], triangle.e1[2]), vec3(triangle.e2[0], triangle.e2[1], triangle.e2[2]));
+	geometric = normalize(dot(geometric, direction) > 0.0f ? -geometric : geometric);
+
+	const Point* n = shape->getNormals()->data();
+	vec3 normal = instance.normalMatrix * vec3(
+		w * n[index.i].x + u * n[index.j].x + v * n[index.k].x,
+		w * n[index.i].y + u * n[index.j].y + v * n[index.k].y,
+		w * n[index.i].z + u * n[index.j].z + v * n[index.k].z);
+	normal = length(normal) > EPSILON ? normalize(normal) : geometric;
+
+	Surface surface;
+	vec3 position = vec3(packet.o[0][lane], packet.o[1][lane], packet.o[2][lane]) + direction * packet.t[lane];
+	float scale = std::max(1.0f, std::max(std::abs(position.x), std::max(std::abs(position.y), std::abs(position.z))));
+	surface.position = position + geometric * (EPSILON * scale);
+	surface.normal = dot(normal, geometric) < 0.0f ? -normal : normal;
+	surface.view = -direction;
+	surface.base = vec3(1.0f);
+	if (vertexColors)
+	{
+		const Color* c = shape->getColors()->data();
+		surface.base = vec3(
+			w * c[index.i].r + u * c[index.j].r + v * c[index.k].r,
+			w * c[index.i].g + u * c[index.j].g + v * c[index.k].g,
+			w * c[index.i].b + u * c[index.j].b + v * c[index.k].b);
+	}
+	surface.diffuse = instance.diffuse;
+	surface.specular = instance.specular;
+	surface.shininess = instance.shininess;
+	return surface;
+}
+
+/*
+ * Closest hits of the packet lanes in mask (or, when any, the lanes blocked before their distance, set in occluded)
+ */
+inline void PathTracer::traverse(Packet* packet, bool any)
+{
+	if (topNodes.empty())
+		return;
+
+	uint32_t stack[MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0 && packet->mask != 0)
+	{
+		uint32_t index = stack[--top];
+		const Node& node = topNodes[index];
+		if (intersect(node, *packet) == 0)
+			continue;
+		if (node.count == 0)
+		{
+			pushChildren(node, index, *packet, stack, &top);
+			continue;
+		}
+		for (uint32_t i = node.offset; i < node.offset + node.count && packet->mask != 0; i++)
+			traverse(instances[i], int(i), packet, any);
+	}
+}
+
+/*
+ * Moves the rays into the local space of the instance (directions are not normalized, so distances are kept) and
+ * traverses its mesh
+ */
+inline void PathTracer::traverse(const Instance& instance, int id, Packet* packet, bool any)
+{
+	Packet local = *packet;
+	const mat4& m = instance.inverse;
+	for (int k = 0; k < 4; k++)
+	{
+		if (!(packet->mask >> k & 1))
+			continue;
+		vec3 o(packet->o[0][k], packet->o[1][k], packet->o[2][k]), d(packet->d[0][k], packet->d[1][k], packet->d[2][k]);
+		for (int a = 0; a < 3; a++)
+		{
+			local.o[a][k] = m[0][a] * o.x + m[1][a] * o.y + m[2][a] * o.z + m[3][a];
+			local.d[a][k] = m[0][a] * d.x + m[1][a] * d.y + m[2][a] * d.z;
+			local.inv[a][k] = 1.0f / local.d[a][k];
+		}
+	}
+
+	const vector<Node>& nodes = instance.mesh->nodes;
+	uint32_t stack[MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0 && local.mask != 0)
+	{
+		uint32_t index = stack[--top];
+		const Node& node = nodes[index];
+		if (intersect(node, local) == 0)
+			continue;
+		if (node.count == 0)
+		{
+			pushChildren(node, index, local, stack, &top);
+			continue;
+		}
+		for (uint32_t i = node.offset; i < node.offset + node.count && local.mask != 0; i++)
+			intersect(instance.mesh->triangles[i], i, id, &local, any);
+	}
+
+	for (int k = 0; k < 4; k++)
+	{
+		packet->t[k] = local.t[k];
+		packet->u[k] = local.u[k];
+		packet->v[k] = local.v[k];
+		packet->instance[k] = local.instance[k];
+		packet->triangle[k] = local.triangle[k];
+	}
+	packet->mask = local.mask;
+	packet->occluded = local.occluded;
+}
+
+/*
+ * Lanes in mask whose ray enters the box before its current distance
+ */
+inline int PathTracer::intersect(const Node& node, const Packet& packet)
+{
+#ifdef PATHTRACER_SSE2
+	__m128 near = _mm_setzero_ps();
+	__m128 far = _mm_load_ps(packet.t);
+	for (int a = 0; a < 3; a++)
+	{
+		__m128 origin = _mm_load_ps(packet.o[a]), inv = _mm_load_ps(packet.inv[a]);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.low[a]), origin), inv);
+		__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.high[a]), origin), inv);
+		near = _mm_max_ps(near, _mm_min_ps(t1, t2));
+		far = _mm_min_ps(far, _mm_max_ps(t1, t2));
+	}
+	return _mm_movemask_ps(_mm_cmple_ps(near, far)) & packet.mask;
+#else
+	int mask = 0;
+	for (int k = 0; k < 4; k++)
+	{
+		float near = 0.0f, far = packet.t[k];
+		for (int a = 0; a < 3; a++)
+		{
+			float t1 = (node.low[a] - packet.o[a][k]) * packet.inv[a][k];
+			float t2 = (node.high[a] - packet.o[a][k]) * packet.inv[a][k];
+			near = std::max(near, std::min(t1, t2));
+			far = std::min(far, std::max(t1, t2));
+		}
+		if (near <= far)
+			mask |= 1 << k;
+	}
+	return mask & packet.mask;
+#endif
+}
+
+/*
+ * Moller-Trumbore test of the lanes in mask against the triangle: closer hits are recorded, while for any hit the
+ * blocked lanes leave the mask
+ */
+inline void PathTracer::intersect(const Triangle& triangle, uint32_t index, int instance, Packet* packet, bool any)
+{
+	alignas(16) float t[4], u[4], v[4];
+	int hits = 0;
+#ifdef PATHTRACER_SSE2
+	__m128 dx = _mm_load_ps(packet->d[0]), dy = _mm_load_ps(packet->d[1]), dz = _mm_load_ps(packet->d[2]);
+	__m128 e1x = _mm_set1_ps(triangle.e1[0]), e1y = _mm_set1_ps(triangle.e1[1]), e1z = _mm_set1_ps(triangle.e1[2]);
+	__m128 e2x = _mm_set1_ps(triangle.e2[0]), e2y = _mm_set1_ps(triangle.e2[1]), e2z = _mm_set1_ps(triangle.e2[2]);
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), det);
+	__m128 tx = _mm_sub_ps(_mm_load_ps(packet->o[0]), _mm_set1_ps(triangle.v0[0]));
+	__m128 ty = _mm_sub_ps(_mm_load_ps(packet->o[1]), _mm_set1_ps(triangle.v0[1]));
+	__m128 tz = _mm_sub_ps(_mm_load_ps(packet->o[2]), _mm_set1_ps(triangle.v0[2]));
+	__m128 hu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inv);
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	__m128 hv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+	__m128 ht = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+	__m128 zero = _mm_setzero_ps();
+	__m128 hit = _mm_and_ps(_mm_cmpneq_ps(det, zero), _mm_and_ps(_mm_cmpge_ps(hu, zero), _mm_cmpge_ps(hv, zero)));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(hu, hv), _mm_set1_ps(1.0f)));
+	hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpgt_ps(ht, zero), _mm_cmplt_ps(ht, _mm_load_ps(packet->t))));
+	hits = _mm_movemask_ps(hit) & packet->mask;
+	_mm_store_ps(t, ht);
+	_mm_store_ps(u, hu);
+	_mm_store_ps(v, hv);
+#else
+	for (int k = 0; k < 4; k++)
+	{
+		float dx = packet->d[0][k], dy = packet->d[1][k], dz = packet->d[2][k];
+		float px = dy * triangle.e2[2] - dz * triangle.e2[1];
+		float py = dz * triangle.e2[0] - dx * triangle.e2[2];
+		float pz = dx * triangle.e2[1] - dy * triangle.e2[0];
+		float det = triangle.e1[0] * px + triangle.e1[1] * py + triangle.e1[2] * pz;
+		float inv = 1.0f / det;
+		float tx = packet->o[0][k] - triangle.v0[0], ty = packet->o[1][k] - triangle.v0[1], tz = packet->o[2][k] - triangle.v0[2];
+		u[k] = (tx * px + ty * py + tz * pz) * inv;
+		float qx = ty * triangle.e1[2] - tz * triangle.e1[1];
+		float qy = tz * triangle.e1[0] - tx * triangle.e1[2];
+		float qz = tx * triangle.e1[1] - ty * triangle.e1[0];
+		v[k] = (dx * qx + dy * qy + dz * qz) * inv;
+		t[k] = (triangle.e2[0] * qx + triangle.e2[1] * qy + triangle.e2[2] * qz) * inv;
+		if (det != 0.0f && u[k] >= 0.0f && v[k] >= 0.0f && u[k] + v[k] <= 1.0f && t[k] > 0.0f && t[k] < packet->t[k])
+			hits |= 1 << k;
+	}
+	hits &= packet->mask;
+#endif
+	if (hits == 0)
+		return;
+	if (any)
+	{
+		packet->occluded |= hits;
+		packet->mask &= ~hits;
+		return;
+	}
+	for (int k = 0; k < 4; k++)
+		if (hits >> k & 1)
+		{
+			packet->t[k] = t[k];
+			packet->u[k] = u[k];
+			packet->v[k] = v[k];
+			packet->instance[k] = instance;
+			packet->triangle[k] = int(index);
+		}
+}
+
+/*
+ * Pushes the children of an inner node, the one on the side the first active ray comes from on top
+ */
+inline void PathTracer::pushChildren(const Node& node, uint32_t index, const Packet& packet, uint32_t* stack, int* top)
+{
+	int lane = 0;
+	while (!(packet.mask >> lane & 1))
+		lane++;
+	bool leftFirst = packet.d[node.axis][lane] >= 0.0f;
+	stack[(*top)++] = leftFirst ? node.offset : index + 1;
+	stack[(*top)++] = leftFirst ? index + 1 : node.offset;
+}
+
+/*
+ * Triangles of the mesh in local coordinates, reordered as the leaves of its BVH reference them
+ */
+inline void PathTracer::buildMesh(Mesh* mesh)
+{
+	Shape* shape = mesh->shape;
+	uint32_t firstTriangle = 0, triangleCount = shape->getIndices()->size();
+	if (mesh->subMesh >= 0)
+	{
+		Shape::SubMesh range = shape->getSubMeshes()->at(mesh->subMesh);
+		firstTriangle = range.firstTriangle;
+		triangleCount = range.triangleCount;
+	}
+
+	const Point* p = shape->getVertices()->data();
+	const Index* indices = shape->getIndices()->data() + firstTriangle;
+	vector<Bounds> boxes(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		boxes[t].grow(vec3(p[indices[t].i].x, p[indices[t].i].y, p[indices[t].i].z));
+		boxes[t].grow(vec3(p[indices[t].j].x, p[indices[t].j].y, p[indices[t].j].z));
+		boxes[t].grow(vec3(p[indices[t].k].x, p[indices[t].k].y, p[indices[t].k].z));
+	}
+
+	vector<uint32_t> order;
+	build(boxes, &order, &mesh->nodes);
+	mesh->triangles.resize(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		Index index = indices[order[t]];
+		Triangle& triangle = mesh->triangles[t];
+		for (int a = 0; a < 3; a++)
+		{
+			double v0 = (&p[index.i].x)[a];
+			triangle.v0[a] = float(v0);
+			triangle.e1[a] = float((&p[index.j].x)[a] - v0);
+			triangle.e2[a] = float((&p[index.k].x)[a] - v0);
+		}
+		triangle.index = firstTriangle + order[t];
+	}
+}
+
+/*
+ * BVH over the boxes, nodes in depth first order (the left child of an inner node follows it, offset is the right
+ * one); order lists the boxes as the leaves reference them
+ */
+inline void PathTracer::build(const vector<Bounds>& boxes, vector<uint32_t>* order, vector<Node>* nodes)
+{
+	nodes->clear();
+	order->resize(boxes.size());
+	for (uint32_t i = 0; i < boxes.size(); i++)
+		(*order)[i] = i;
+	if (boxes.empty())
+		return;
+	nodes->reserve(2 * boxes.size());
+	split(boxes, order, 0, boxes.size(), 0, nodes);
+}
+
+/*
+ * Splits the range at the best of BINS planes along the widest axis of the box centers (surface area heuristic),
+ * in the middle when no plane separates them, and makes a leaf when small enough or when splitting costs more
+ */
+inline uint32_t PathTracer::split(const vector<Bounds>& boxes, vector<uint32_t>* order, uint32_t first, uint32_t count, int depth, vector<Node>* nodes)
+{
+	uint32_t index = nodes->size();
+	nodes->push_back(Node());
+
+	Bounds bounds, centers;
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const Bounds& box = boxes[(*order)[i]];
+		bounds.grow(box);
+		centers.grow((box.low + box.high) * 0.5f);
+	}
+	Node node;
+	for (int a = 0; a < 3; a++)
+	{
+		node.low[a] = bounds.low[a];
+		node.high[a] = bounds.high[a];
+	}
+	node.offset = first;
+	node.count = count;
+	node.axis = 0;
+
+	vec3 extent = centers.high - centers.low;
+	int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+	if (count <= uint32_t(LEAF_SIZE) || depth >= MAX_DEPTH)
+	{
+		(*nodes)[index] = node;
+		return index;
+	}
+
+	uint32_t* range = order->data() + first;
+	uint32_t middle = 0;
+	if (extent[axis] > 0.0f)
+	{
+		Bounds bins[BINS];
+		uint32_t binCounts[BINS] = { 0 };
+		float binScale = BINS / extent[axis];
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const Bounds& box = boxes[range[i]];
+			int b = std::min(BINS - 1, int(((box.low[axis] + box.high[axis]) * 0.5f - centers.low[axis]) * binScale));
+			bins[b].grow(box);
+			binCounts[b]++;
+		}
+
+		float rightAreas[BINS];
+		Bounds right;
+		for (int b = BINS - 1; b > 0; b--)
+		{
+			right.grow(bins[b]);
+			rightAreas[b] = right.getArea();
+		}
+		Bounds left;
+		uint32_t leftCount = 0;
+		float bestCost = numeric_limits<float>::max();
+		int bestBin = -1;
+		for (int b = 1; b < BINS; b++)
+		{
+			left.grow(bins[b - 1]);
+			leftCount += binCounts[b - 1];
+			float cost = left.getArea() * leftCount + rightAreas[b] * (count - leftCount);
+			if (leftCount > 0 && leftCount < count && cost < bestCost)
+			{
+				bestCost = cost;
+				bestBin = b;
+			}
+		}
+
+		if (count <= uint32_t(MAX_LEAF) && (bestBin < 0 || bestCost >= bounds.getArea() * count))
+		{
+			(*nodes)[index] = node;
+			return index;
+		}
+		if (bestBin > 0)
+			middle = uint32_t(std::partition(range, range + count, [&](uint32_t i) {
+				const Bounds& box = boxes[i];
+				return std::min(BINS - 1, int(((box.low[axis] + box.high[axis]) * 0.5f - centers.low[axis]) * binScale)) < bestBin;
+			}) - range);
+	}
+	if (middle == 0 || middle == count)
+	{
+		middle = count / 2;
+		std::nth_element(range, range + middle, range + count, [&](uint32_t i, uint32_t j) {
+			return boxes[i].low[axis] + boxes[i].high[axis] < boxes[j].low[axis] + boxes[j].high[axis];
+		});
+	}
+
+	node.count = 0;
+	node.axis = axis;
+	(*nodes)[index] = node;
+	split(boxes, order, first, middle, depth + 1, nodes);
+	(*nodes)[index].offset = split(boxes, order, first + middle, count - middle, depth + 1, nodes);
+	return index;
+}
+
+/*
+ * Integer mixing (lowbias32), seeding the generator of a pixel at a pass
+ */
+inline uint32_t PathTracer::hash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
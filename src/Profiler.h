@@ -0,0 +1,219 @@
+#pragma once
+#include "Utils.h"
+#include <chrono>
+#include <algorithm>
+
+/*
+ * Per-Frame CPU/GPU Timing and Shaded Fragments
+ *
+ * The fragments are the samples passed between beginSamples and endSamples (the shading pass, leaving out a depth
+ * pre-pass), so that divided by the pixels they give the overdraw; frames with no such bracket report -1. Without
+ * history no frame is kept, only the GPU time last read back (for long interactive sessions)
+ */
+class Profiler
+{
+public:
+	struct Frame {
+		double cpuTime;
+		double gpuTime;
+		double fragments;
+	};
+
+	Profiler(bool history = true);
+	~Profiler();
+
+	Profiler* beginFrame();
+	Profiler* endFrame(bool wait = false);
+	Profiler* beginSamples();
+	Profiler* endSamples();
+	Frame getLastFrame();
+	vector<Frame>* getFrames();
+	double getPercentile(double percentile, bool gpu = false);
+	double getAverage(bool gpu = false);
+	double getAverageFragments();
+	double getLatestGpuTime();
+	Profiler* reset();
+
+private:
+	static const int QUERIES = 4;
+
+	GLuint queries[QUERIES];
+	GLuint sampleQueries[QUERIES];
+	bool pending[QUERIES];
+	bool sampled[QUERIES];
+	size_t owners[QUERIES];
+	int current;
+	bool history;
+	double latestGpuTime;
+	chrono::steady_clock::time_point start;
+	vector<Frame> frames;
+
+	void collect(int query, bool wait);
+};
+
+inline Profiler::Profiler(bool history)
+{
+	this->history = history;
+	latestGpuTime = -1.0;
+	glGenQueries(QUERIES, queries);
+	glGenQueries(QUERIES, sampleQueries);
+	for (int i = 0; i < QUERIES; i++)
+		pending[i] = sampled[i] = false;
+	current = 0;
+}
+
+inline Profiler::~Profiler()
+{
+	glDeleteQueries(QUERIES, queries);
+	glDeleteQueries(QUERIES, sampleQueries);
+}
+
+inline Profiler* Profiler::beginFrame()
+{
+	if (pending[current])
+		collect(current, true);
+
+	sampled[current] = false;
+	start = chrono::steady_clock::now();
+	glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+	return this;
+}
+
+/*
+ * GPU times are read back QUERIES frames later, unless wait is set
+ */
+inline Profiler* Profiler::endFrame(bool wait)
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	if (wait)
+		glFinish();
+
+	double cpuTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	if (history)
+		frames.push_back({ cpuTime, -1.0, -1.0 });
+	pending[current] = true;
+	owners[current] = history ? frames.size() - 1 : frames.size();
+	if (wait)
+		collect(current, true);
+	current = (current + 1) % QUERIES;
+	return this;
+}
+
+/*
+ * At most once per frame, between beginFrame and endFrame
+ */
+inline Profiler* Profiler::beginSamples()
+{
+	glBeginQuery(GL_SAMPLES_PASSED, sampleQueries[current]);
+	sampled[current] = true;
+	return this;
+}
+
+inline Profiler* Profiler::endSamples()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+	return this;
+}
+
+inline Profiler::Frame Profiler::getLastFrame()
+{
+	return frames.empty() ? Frame({ 0.0, 0.0, -1.0 }) : frames.back();
+}
+
+inline vector<Profiler::Frame>* Profiler::getFrames()
+{
+	return &frames;
+}
+
+inline double Profiler::getPercentile(double percentile, bool gpu)
+{
+	vector<double> times;
+	for (Frame frame : frames)
+	{
+		double time = gpu ? frame.gpuTime : frame.cpuTime;
+		if (time >= 0.0)
+			times.push_back(time);
+	}
+	if (times.empty())
+		return 0.0;
+
+	size_t index = std::min(times.size() - 1, size_t(percentile / 100.0 * times.size()));
+	nth_element(times.begin(), times.begin() + index, times.end());
+	return times[index];
+}
+
+inline double Profiler::getAverage(bool gpu)
+{
+	double sum = 0.0;
+	int count = 0;
+	for (Frame frame : frames)
+	{
+		double time = gpu ? frame.gpuTime : frame.cpuTime;
+		if (time >= 0.0)
+		{
+			sum += time;
+			count++;
+		}
+	}
+	return count == 0 ? 0.0 : sum / count;
+}
+
+inline double Profiler::getAverageFragments()
+{
+	double sum = 0.0;
+	int count = 0;
+	for (Frame frame : frames)
+	{
+		if (frame.fragments >= 0.0)
+		{
+			sum += frame.fragments;
+			count++;
+		}
+	}
+	return count == 0 ? 0.0 : sum / count;
+}
+
+/*
+ * GPU time of the newest frame read back so far, -1 before the first
+ */
+inline double Profiler::getLatestGpuTime()
+{
+	return latestGpuTime;
+}
+
+inline Profiler* Profiler::reset()
+{
+	for (int i = 0; i < QUERIES; i++)
+	{
+		if (pending[i])
+			collect(i, true);
+	}
+	frames.clear();
+	return this;
+}
+
+inline void Profiler::collect(int query, bool wait)
+{
+	GLint available = 0;
+	if (!wait)
+	{
+		glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return;
+	}
+
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &elapsed);
+	pending[query] = false;
+	latestGpuTime = elapsed / 1.0e6;
+	if (owners[query] < frames.size())
+		frames[owners[query]].gpuTime = elapsed / 1.0e6;
+
+	if (!sampled[query])
+		return;
+	GLuint64 samples = 0;
+	glGetQueryObjectui64v(sampleQueries[query], GL_QUERY_RESULT, &samples);
+	sampled[query] = false;
+	if (owners[query] < frames.size())
+		frames[owners[query]].fragments = double(samples);
+}
\ No newline at end of file
@@ -1,120 +1,131 @@
-#pragma once
-#include "Utils.h"
-#include "Model.h"
-#include "View.h"
-#include "Projection.h"
-#include "Shader.h"
-#include <stack>
-
-class Program
-{
-public:
-	static void initDefault();
-	static Model* getModel();
-	static View* getView();
-	static Projection* getProjection();
-	static Shader* getShader();
-
-	static void pushModel(Model* model);
-	static void pushView(View* view);
-	static void pushProjection(Projection* projection);
-	static void pushShader(Shader* shader);
-	static void popModel();
-	static void popView();
-	static void popProjection();
-	static void popShader();
-
-private:
-	Program();
-
-	static stack<Model*> models;
-	static stack<View*> views;
-	static stack<Projection*> projections;
-	static stack<Shader*> shaders;
-	static Optional<int> selectedBody;
-};
-
-stack<Model*> Program::models;
-stack<View*> Program::views;
-stack<Projection*> Program::projections;
-stack<Shader*> Program::shaders;
-
-inline void Program::initDefault()
-{
-	pushModel(new Model());
-	pushView(new View());
-	pushProjection(new Projection());
-	pushShader(new Shader());
-}
-
-inline Model* Program::getModel()
-{
-	return models.top();
-}
-
-inline View* Program::getView()
-{
-	return views.top();
-}
-
-inline Projection* Program::getProjection()
-{
-	return projections.top();
-}
-
-inline Shader * Program::getShader()
-{
-	return shaders.top();
-}
-
-inline void Program::pushModel(Model* model)
-{
-	models.push(new Model(*model));
-}
-
-inline void Program::pushView(View* view)
-{
-	views.push(new View(*view));
-}
-
-inline void Program::pushProjection(Projection* projection)
-{
-	projections.push(new Projection(*projection));
-}
-
-inline void Program::pushShader(Shader* shader)
-{
-	shaders.push(new Shader(*shader));
-}
-
-inline void Program::popModel()
-{
-	delete getModel();
-	models.pop();
-	if (models.empty())
-		pushModel(new Model());
-}
-
-inline void Program::popView()
-{
-	delete getView();
-	views.pop();
-	if (views.empty())
-		pushView(new View());
-}
-
-inline void Program::popProjection()
-{
-	delete getProjection();
-	projections.pop();
-	if (projections.empty())
-		pushProjection(new Projection());
-}
-
-inline void Program::popShader()
-{
-	delete getShader();
-	shaders.pop();
-	if (shaders.empty())
-		pushShader(new Shader());
+#pragma once
+#include "Utils.h"
+#include "Model.h"
+#include "View.h"
+#include "Projection.h"
+#include "Shader.h"
+
+/*
+ * Context Stacks for the Current Transformations and Shader
+ */
+class Program
+{
+public:
+	static void initDefault();
+	static Model* getModel();
+	static View* getView();
+	static Projection* getProjection();
+	static Shader* getShader();
+
+	static void pushModel(const Model& model);
+	static void pushView(const View& view);
+	static void pushProjection(const Projection& projection);
+	static void pushShader(Shader* shader);
+	static void popModel();
+	static void popView();
+	static void popProjection();
+	static Shader* popShader();
+
+private:
+	static const int CAPACITY = 8;
+
+	Program();
+
+	static FixedStack<Model, CAPACITY> models;
+	static FixedStack<View, CAPACITY> views;
+	static FixedStack<Projection, CAPACITY> projections;
+	static FixedStack<Shader*, CAPACITY> shaders;
+	static Optional<int> selectedBody;
+};
+
+FixedStack<Model, Program::CAPACITY> Program::models;
+FixedStack<View, Program::CAPACITY> Program::views;
+FixedStack<Projection, Program::CAPACITY> Program::projections;
+FixedStack<Shader*, Program::CAPACITY> Program::shaders;
+
+/*
+ * Models, views and projections are stored by value; shaders are only referenced, so none is pushed here: whoever
+ * pushes a shader owns it
+ */
+inline void Program::initDefault()
+{
+	models.emplace();
+	views.emplace();
+	projections.emplace();
+}
+
+inline Model* Program::getModel()
+{
+	return models.top();
+}
+
+inline View* Program::getView()
+{
+	return views.top();
+}
+
+inline Projection* Program::getProjection()
+{
+	return projections.top();
+}
+
+/*
+ * Unlike the other stacks, the shader one starts empty (see initDefault), so it is checked in every build
+ */
+inline Shader * Program::getShader()
+{
+	if (shaders.empty())
+		throw "no shader pushed";
+	return *shaders.top();
+}
+
+inline void Program::pushModel(const Model& model)
+{
+	models.push(model);
+}
+
+inline void Program::pushView(const View& view)
+{
+	views.push(view);
+}
+
+inline void Program::pushProjection(const Projection& projection)
+{
+	projections.push(projection);
+}
+
+inline void Program::pushShader(Shader* shader)
+{
+	shaders.push(shader);
+}
+
+inline void Program::popModel()
+{
+	models.pop();
+	if (models.empty())
+		models.emplace();
+}
+
+inline void Program::popView()
+{
+	views.pop();
+	if (views.empty())
+		views.emplace();
+}
+
+inline void Program::popProjection()
+{
+	projections.pop();
+	if (projections.empty())
+		projections.emplace();
+}
+
+/*
+ * Returns the popped shader, still owned by the caller that pushed it
+ */
+inline Shader* Program::popShader()
+{
+	Shader* shader = getShader();
+	shaders.pop();
+	return shader;
 }
\ No newline at end of file
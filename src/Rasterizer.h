@@ -0,0 +1,679 @@
+#pragma once
+#include "Utils.h"
+#include "Shape.h"
+#include "Global.h"
+#include "Program.h"
+#include "Image.h"
+#include "Parallel.h"
+#include "RigidBody.h"
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RASTERIZER_SSE2
+#endif
+
+/*
+ * Multithreaded Tiled Software Rasterizer of the Vertex Lighting Pipeline
+ *
+ * Draws shapes (from their CPU mirrors) the way VectorShaderWithLights.glsl and FragmentShader.glsl do with no PER_PIXEL
+ * or CLUSTERED feature, with no OpenGL context. render transforms and lights the vertices 4 at a time (SSE2, with a
+ * scalar fallback), clips the triangles against the near plane and a guard band, sets them up in fixed point (SUBPIXEL_BITS,
+ * top-left fill rule) and bins them into TILE_SIZE square screen tiles, which the hardware threads then clear and fill
+ * with a depth test (GL_LESS) and perspective-correct colors. Work is split into fixed blocks merged in order, and each
+ * tile draws its triangles in submission order, so frames do not depend on the number of threads or their timing
+ */
+class Rasterizer
+{
+public:
+	static bool ENABLED;
+	static const int TILE_SIZE;
+	static const int SUBPIXEL_BITS;
+	static const float GUARD_BAND;
+	static const GLuint VERTEX_BLOCK;
+	static const GLuint TRIANGLE_BLOCK;
+
+	Rasterizer(int width, int height);
+	~Rasterizer();
+
+	int getWidth();
+	int getHeight();
+	Rasterizer* resize(int width, int height);
+	Rasterizer* setLights(const vector<vec3>& positions);
+	Rasterizer* setVertexColors(bool vertexColors);
+	Rasterizer* clear();
+	Rasterizer* add(const Material* material, Shape* shape, int subMesh, const mat4& transform);
+	Rasterizer* add(RigidBody* body);
+	Rasterizer* render();
+	Rasterizer* capture(Image* image);
+	Rasterizer* blit();
+	int getTriangles();
+
+private:
+	struct Draw {
+		Shape* shape;
+		GLuint firstVertex, vertexCount;
+		GLuint firstTriangle, triangleCount;
+		mat4 model;
+		mat4 mvp;
+		mat3 normalMatrix;
+		vec3 ambient, diffuse, specular;
+		float shininess;
+		size_t output;
+	};
+
+	struct Block {
+		size_t draw;
+		GLuint first, count;
+	};
+
+	struct Vertex {
+		vec4 position;
+		vec4 color;
+	};
+
+	struct Triangle {
+		int64_t a[3], b[3], c[3];
+		float invArea;
+		float depth[3];
+		float invW[3];
+		vec4 color[3];
+		int minX, minY, maxX, maxY;
+	};
+
+	int width, height, tilesX, tilesY;
+	vector<vec3> lights;
+	bool vertexColors;
+	vec3 eye;
+	vector<Draw> draws;
+	vector<Block> blocks;
+	vector<Vertex> vertices;
+	vector<vector<Triangle>> setups;
+	vector<Triangle> triangles;
+	vector<vector<uint32_t>> bins;
+	vector<unsigned char> colors;
+	vector<float> depths;
+	GLuint texture, framebuffer;
+	int textureWidth, textureHeight;
+
+	void shade(const Draw& draw, GLuint first, GLuint count);
+	void shadeScalar(const Draw& draw, const Point& p, const Point& n, const Color& c, Vertex* out);
+#ifdef RASTERIZER_SSE2
+	void shadeSSE2(const Draw& draw, const Point* p, const Point* n, const Color* c, Vertex* out);
+	static __m128 dot(const __m128* a, const __m128* b);
+	static void normalize(__m128* v);
+#endif
+	void assemble(const Draw& draw, GLuint first, GLuint count, vector<Triangle>* out);
+	void setup(const Vertex* v0, const Vertex* v1, const Vertex* v2, vector<Triangle>* out);
+	void rasterize(size_t tile);
+	static float getDistance(const vec4& position, int plane);
+};
+
+bool Rasterizer::ENABLED = false;
+const int Rasterizer::TILE_SIZE = 64;
+const int Rasterizer::SUBPIXEL_BITS = 4;
+const float Rasterizer::GUARD_BAND = 8.0f;
+const GLuint Rasterizer::VERTEX_BLOCK = 1024;
+const GLuint Rasterizer::TRIANGLE_BLOCK = 2048;
+
+inline Rasterizer::Rasterizer(int width, int height)
+{
+	this->width = this->height = 0;
+	vertexColors = false;
+	lights.assign(1, vec3(0.0f));
+	texture = framebuffer = 0;
+	textureWidth = textureHeight = 0;
+	resize(width, height);
+}
+
+/*
+ * The GL objects only exist if blit was called
+ */
+inline Rasterizer::~Rasterizer()
+{
+	if (texture != 0)
+	{
+		glDeleteTextures(1, &texture);
+		glDeleteFramebuffers(1, &framebuffer);
+	}
+}
+
+inline int Rasterizer::getWidth()
+{
+	return width;
+}
+
+inline int Rasterizer::getHeight()
+{
+	return height;
+}
+
+inline Rasterizer* Rasterizer::resize(int width, int height)
+{
+	this->width = std::max(width, 1);
+	this->height = std::max(height, 1);
+	tilesX = (this->width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (this->height + TILE_SIZE - 1) / TILE_SIZE;
+	bins.resize(size_t(tilesX) * tilesY);
+	colors.assign(size_t(this->width) * this->height * 3, 0);
+	depths.assign(size_t(this->width) * this->height, 1.0f);
+	return this;
+}
+
+/*
+ * Positions of the point lights of the vertex shader, as many as it uses
+ */
+inline Rasterizer* Rasterizer::setLights(const vector<vec3>& positions)
+{
+	lights = positions;
+	return this;
+}
+
+/*
+ * Whether the vertex colors tint the lighting, as in the VERTEX_COLORS variants (white otherwise)
+ */
+inline Rasterizer* Rasterizer::setVertexColors(bool vertexColors)
+{
+	this->vertexColors = vertexColors;
+	return this;
+}
+
+inline Rasterizer* Rasterizer::clear()
+{
+	draws.clear();
+	return this;
+}
+
+/*
+ * Queues the sub-mesh (all of them when negative) of the shape with the current model matrix multiplied by the given
+ * one, like RenderQueue::add; shapes without their CPU mirror cannot be drawn and are skipped
+ */
+inline Rasterizer* Rasterizer::add(const Material* material, Shape* shape, int subMesh, const mat4& transform)
+{
+	if (shape == NULL || !shape->hasMirror() || shape->getVertices()->empty())
+		return this;
+
+	Draw draw;
+	draw.shape = shape;
+	if (subMesh >= 0)
+	{
+		Shape::SubMesh range = shape->getSubMeshes()->at(subMesh);
+		draw.firstVertex = range.firstVertex;
+		draw.vertexCount = range.vertexCount;
+		draw.firstTriangle = range.firstTriangle;
+		draw.triangleCount = range.triangleCount;
+	}
+	else
+	{
+		draw.firstVertex = draw.firstTriangle = 0;
+		draw.vertexCount = shape->getVertices()->size();
+		draw.triangleCount = shape->getIndices()->size();
+	}
+	draw.model = Program::getModel()->getMatrix() * transform;
+	draw.normalMatrix = transpose(inverse(mat3(draw.model)));
+	draw.ambient = World::DEFAULT_LIGHT.ambient * material->ambient;
+	draw.diffuse = World::DEFAULT_LIGHT.diffuse * material->diffuse;
+	draw.specular = World::DEFAULT_LIGHT.specular * material->specular;
+	draw.shininess = material->shininess;
+	draws.push_back(draw);
+	return this;
+}
+
+/*
+ * Queues the shape of the body at its level of detail, with the body material
+ */
+inline Rasterizer* Rasterizer::add(RigidBody* body)
+{
+	if (body->getShape() == NULL)
+		return this;
+
+	const Material* m = body->isSelected() ? &World::SELECTED_MATERIAL : &World::DEFAULT_MATERIAL;
+	return add(m, body->getShape(), body->selectLevel(), body->getTransform());
+}
+
+/*
+ * Draws the queued shapes with the current view and projection into the color and depth buffers, cleared first
+ */
+inline Rasterizer* Rasterizer::render()
+{
+	mat4 viewProjection = Program::getProjection()->getMatrix() * Program::getView()->getMatrix();
+	eye = Program::getView()->getPosition();
+
+	size_t total = 0;
+	blocks.clear();
+	for (size_t d = 0; d < draws.size(); d++)
+	{
+		draws[d].mvp = viewProjection * draws[d].model;
+		draws[d].output = total;
+		for (GLuint first = 0; first < draws[d].vertexCount; first += VERTEX_BLOCK)
+			blocks.push_back({ d, first, std::min(VERTEX_BLOCK, draws[d].vertexCount - first) });
+		total += draws[d].vertexCount;
+	}
+	vertices.resize(total);
+	Parallel::forEach(blocks.size(), [&](size_t b) {
+		shade(draws[blocks[b].draw], blocks[b].first, blocks[b].count);
+	});
+
+	blocks.clear();
+	for (size_t d = 0; d < draws.size(); d++)
+	{
+		for (GLuint first = 0; first < draws[d].triangleCount; first += TRIANGLE_BLOCK)
+			blocks.push_back({ d, first, std::min(TRIANGLE_BLOCK, draws[d].triangleCount - first) });
+	}
+	setups.resize(std::max(setups.size(), blocks.size()));
+	Parallel::forEach(blocks.size(), [&](size_t b) {
+		setups[b].clear();
+		assemble(draws[blocks[b].draw], blocks[b].first, blocks[b].count, &setups[b]);
+	});
+
+	// binning is sequential, so that every tile lists its triangles in submission order
+	triangles.clear();
+	for (size_t b = 0; b < blocks.size(); b++)
+		triangles.insert(triangles.end(), setups[b].begin(), setups[b].end());
+	for (vector<uint32_t>& bin : bins)
+		bin.clear();
+	for (uint32_t t = 0; t < triangles.size(); t++)
+	{
+		const Triangle& triangle = triangles[t];
+		for (int y = triangle.minY / TILE_SIZE; y <= triangle.maxY / TILE_SIZE; y++)
+			for (int x = triangle.minX / TILE_SIZE; x <= triangle.maxX / TILE_SIZE; x++)
+				bins[size_t(y) * tilesX + x].push_back(t);
+	}
+
+	Parallel::forEach(bins.size(), [&](size_t tile) {
+		rasterize(tile);
+	});
+	return this;
+}
+
+/*
+ * Copies the color buffer (bottom row first, as in OpenGL) into an image of the same size, top row first
+ */
+inline Rasterizer* Rasterizer::capture(Image* image)
+{
+	if (image->getWidth() != width || image->getHeight() != height)
+		throw "image and rasterizer sizes differ";
+	copy(colors.begin(), colors.end(), image->getPixels());
+	image->flipVertically();
+	return this;
+}
+
+/*
+ * Uploads the color buffer into a texture and copies it to the draw framebuffer (needs an OpenGL context)
+ */
+inline Rasterizer* Rasterizer::blit()
+{
+	if (texture == 0)
+	{
+		glGenTextures(1, &texture);
+		glGenFramebuffers(1, &framebuffer);
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (textureWidth != width || textureHeight != height)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, colors.data());
+		textureWidth = width;
+		textureHeight = height;
+	}
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, colors.data());
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return this;
+}
+
+/*
+ * Triangles set up in the last render, after culling and clipping
+ */
+inline int Rasterizer::getTriangles()
+{
+	return triangles.size();
+}
+
+inline void Rasterizer::shade(const Draw& draw, GLuint first, GLuint count)
+{
+	const Point* p = draw.shape->getVertices()->data() + draw.firstVertex + first;
+	const Point* n = draw.shape->getNormals()->data() + draw.firstVertex + first;
+	const Color* c = draw.shape->getColors()->data() + draw.firstVertex + first;
+	Vertex* out = vertices.data() + draw.output + first;
+	GLuint i = 0;
+#ifdef RASTERIZER_SSE2
+	for (; i + 4 <= count; i += 4)
+		shadeSSE2(draw, p + i, n + i, c + i, out + i);
+#endif
+	for (; i < count; i++)
+		shadeScalar(draw, p[i], n[i], c[i], out + i);
+}
+
+/*
+ * Same operations, in the same order, as the SSE2 path
+ */
+inline void Rasterizer::shadeScalar(const Draw& draw, const Point& p, const Point& n, const Color& c, Vertex* out)
+{
+	const float* mvp = value_ptr(draw.mvp);
+	const float* model = value_ptr(draw.model);
+	const float* normal = value_ptr(draw.normalMatrix);
+	float x = float(p.x), y = float(p.y), z = float(p.z);
+	float nx = float(n.x), ny = float(n.y), nz = float(n.z);
+
+	float clip[4], world[3], N[3], V[3];
+	for (int r = 0; r < 4; r++)
+		clip[r] = (mvp[r] * x + mvp[4 + r] * y) + (mvp[8 + r] * z + mvp[12 + r]);
+	for (int r = 0; r < 3; r++)
+	{
+		world[r] = (model[r] * x + model[4 + r] * y) + (model[8 + r] * z + model[12 + r]);
+		N[r] = (normal[r] * nx + normal[3 + r] * ny) + normal[6 + r] * nz;
+	}
+	float reciprocal = 1.0f / sqrt(std::max((N[0] * N[0] + N[1] * N[1]) + N[2] * N[2], 1e-30f));
+	for (int r = 0; r < 3; r++)
+	{
+		N[r] *= reciprocal;
+		V[r] = eye[r] - world[r];
+	}
+	reciprocal = 1.0f / sqrt(std::max((V[0] * V[0] + V[1] * V[1]) + V[2] * V[2], 1e-30f));
+	for (int r = 0; r < 3; r++)
+		V[r] *= reciprocal;
+
+	float light[3] = { draw.ambient.x, draw.ambient.y, draw.ambient.z };
+	for (vec3 position : lights)
+	{
+		float L[3], R[3];
+		for (int r = 0; r < 3; r++)
+			L[r] = position[r] - world[r];
+		reciprocal = 1.0f / sqrt(std::max((L[0] * L[0] + L[1] * L[1]) + L[2] * L[2], 1e-30f));
+		for (int r = 0; r < 3; r++)
+			L[r] *= reciprocal;
+		float ln = (L[0] * N[0] + L[1] * N[1]) + L[2] * N[2];
+		for (int r = 0; r < 3; r++)
+			R[r] = 2.0f * ln * N[r] - L[r];
+		reciprocal = 1.0f / sqrt(std::max((R[0] * R[0] + R[1] * R[1]) + R[2] * R[2], 1e-30f));
+		for (int r = 0; r < 3; r++)
+			R[r] *= reciprocal;
+		float diffuse = std::max(ln, 0.0f);
+		float specular = pow(std::max((R[0] * V[0] + R[1] * V[1]) + R[2] * V[2], 0.0f), draw.shininess);
+		for (int r = 0; r < 3; r++)
+			light[r] = (light[r] + draw.diffuse[r] * diffuse) + draw.specular[r] * specular;
+	}
+
+	vec4 base = vertexColors ? vec4(float(c.r), float(c.g), float(c.b), float(c.a)) : vec4(1.0f);
+	out->position = vec4(clip[0], clip[1], clip[2], clip[3]);
+	out->color = vec4(base.x * light[0], base.y * light[1], base.z * light[2], base.w);
+}
+
+#ifdef RASTERIZER_SSE2
+/*
+ * Four vertices at a time, one per lane; only the specular power is taken lane by lane
+ */
+inline void Rasterizer::shadeSSE2(const Draw& draw, const Point* p, const Point* n, const Color* c, Vertex* out)
+{
+	const float* mvp = value_ptr(draw.mvp);
+	const float* model = value_ptr(draw.model);
+	const float* normal = value_ptr(draw.normalMatrix);
+	const __m128 zero = _mm_setzero_ps(), two = _mm_set1_ps(2.0f);
+	__m128 x = _mm_setr_ps(float(p[0].x), float(p[1].x), float(p[2].x), float(p[3].x));
+	__m128 y = _mm_setr_ps(float(p[0].y), float(p[1].y), float(p[2].y), float(p[3].y));
+	__m128 z = _mm_setr_ps(float(p[0].z), float(p[1].z), float(p[2].z), float(p[3].z));
+	__m128 nx = _mm_setr_ps(float(n[0].x), float(n[1].x), float(n[2].x), float(n[3].x));
+	__m128 ny = _mm_setr_ps(float(n[0].y), float(n[1].y), float(n[2].y), float(n[3].y));
+	__m128 nz = _mm_setr_ps(float(n[0].z), float(n[1].z), float(n[2].z), float(n[3].z));
+
+	__m128 clip[4], world[3], N[3], V[3];
+	for (int r = 0; r < 4; r++)
+		clip[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(mvp[r]), x), _mm_mul_ps(_mm_set1_ps(mvp[4 + r]), y)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(mvp[8 + r]), z), _mm_set1_ps(mvp[12 + r])));
+	for (int r = 0; r < 3; r++)
+	{
+		world[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(model[r]), x), _mm_mul_ps(_mm_set1_ps(model[4 + r]), y)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(model[8 + r]), z), _mm_set1_ps(model[12 + r])));
+		N[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(normal[r]), nx), _mm_mul_ps(_mm_set1_ps(normal[3 + r]), ny)), _mm_mul_ps(_mm_set1_ps(normal[6 + r]), nz));
+		V[r] = _mm_sub_ps(_mm_set1_ps(eye[r]), world[r]);
+	}
+	normalize(N);
+	normalize(V);
+
+	__m128 light[3] = { _mm_set1_ps(draw.ambient.x), _mm_set1_ps(draw.ambient.y), _mm_set1_ps(draw.ambient.z) };
+	for (vec3 position : lights)
+	{
+		__m128 L[3], R[3];
+		for (int r = 0; r < 3; r++)
+			L[r] = _mm_sub_ps(_mm_set1_ps(position[r]), world[r]);
+		normalize(L);
+		__m128 ln = dot(L, N);
+		for (int r = 0; r < 3; r++)
+			R[r] = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(two, ln), N[r]), L[r]);
+		normalize(R);
+		__m128 diffuse = _mm_max_ps(ln, zero);
+
+		float cosines[4];
+		_mm_storeu_ps(cosines, _mm_max_ps(dot(R, V), zero));
+		for (int k = 0; k < 4; k++)
+			cosines[k] = pow(cosines[k], draw.shininess);
+		__m128 specular = _mm_loadu_ps(cosines);
+		for (int r = 0; r < 3; r++)
+			light[r] = _mm_add_ps(_mm_add_ps(light[r], _mm_mul_ps(_mm_set1_ps(draw.diffuse[r]), diffuse)), _mm_mul_ps(_mm_set1_ps(draw.specular[r]), specular));
+	}
+
+	float positions[4][4], lit[3][4];
+	for (int r = 0; r < 4; r++)
+		_mm_storeu_ps(positions[r], clip[r]);
+	for (int r = 0; r < 3; r++)
+		_mm_storeu_ps(lit[r], light[r]);
+	for (int k = 0; k < 4; k++)
+	{
+		vec4 base = vertexColors ? vec4(float(c[k].r), float(c[k].g), float(c[k].b), float(c[k].a)) : vec4(1.0f);
+		out[k].position = vec4(positions[0][k], positions[1][k], positions[2][k], positions[3][k]);
+		out[k].color = vec4(base.x * lit[0][k], base.y * lit[1][k], base.z * lit[2][k], base.w);
+	}
+}
+
+inline __m128 Rasterizer::dot(const __m128* a, const __m128* b)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+}
+
+inline void Rasterizer::normalize(__m128* v)
+{
+	__m128 reciprocal = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(dot(v, v), _mm_set1_ps(1e-30f))));
+	for (int r = 0; r < 3; r++)
+		v[r] = _mm_mul_ps(v[r], reciprocal);
+}
+#endif
+
+/*
+ * Clips the triangles of the block: those outside the frustum are dropped, those crossing the near plane or the guard
+ * band (GUARD_BAND times the viewport, which keeps the fixed point coordinates small) are cut into a fan
+ */
+inline void Rasterizer::assemble(const Draw& draw, GLuint first, GLuint count, vector<Triangle>* out)
+{
+	const Index* indices = draw.shape->getIndices()->data() + draw.firstTriangle + first;
+	const Vertex* base = vertices.data() + draw.output;
+	for (GLuint t = 0; t < count; t++)
+	{
+		const Vertex* v[3] = { base + (indices[t].i - draw.firstVertex), base + (indices[t].j - draw.firstVertex), base + (indices[t].k - draw.firstVertex) };
+
+		bool outside = false;
+		for (int axis = 0; axis < 3 && !outside; axis++)
+		{
+			outside = (v[0]->position[axis] > v[0]->position.w && v[1]->position[axis] > v[1]->position.w && v[2]->position[axis] > v[2]->position.w)
+				|| (v[0]->position[axis] < -v[0]->position.w && v[1]->position[axis] < -v[1]->position.w && v[2]->position[axis] < -v[2]->position.w);
+		}
+		if (outside)
+			continue;
+
+		unsigned int codes = 0;
+		for (int plane = 0; plane < 5; plane++)
+			for (int k = 0; k < 3; k++)
+				if (getDistance(v[k]->position, plane) < 0.0f)
+					codes |= 1u << plane;
+		if (codes == 0)
+		{
+			setup(v[0], v[1], v[2], out);
+			continue;
+		}
+
+		// Sutherland-Hodgman, each plane adding at most one vertex
+		Vertex polygons[2][8];
+		int size = 3;
+		for (int k = 0; k < 3; k++)
+			polygons[0][k] = *v[k];
+		int current = 0;
+		for (int plane = 0; plane < 5 && size >= 3; plane++)
+		{
+			if (!(codes & (1u << plane)))
+				continue;
+			Vertex* in = polygons[current];
+			Vertex* clipped = polygons[1 - current];
+			int clippedSize = 0;
+			for (int k = 0; k < size; k++)
+			{
+				const Vertex& a = in[k];
+				const Vertex& b = in[(k + 1) % size];
+				float da = getDistance(a.position, plane), db = getDistance(b.position, plane);
+				if (da >= 0.0f)
+					clipped[clippedSize++] = a;
+				if ((da >= 0.0f) != (db >= 0.0f))
+				{
+					float s = da / (da - db);
+					clipped[clippedSize++] = { a.position + s * (b.position - a.position), a.color + s * (b.color - a.color) };
+				}
+			}
+			size = clippedSize;
+			current = 1 - current;
+		}
+		for (int k = 1; k + 1 < size; k++)
+			setup(&polygons[current][0], &polygons[current][k], &polygons[current][k + 1], out);
+	}
+}
+
+/*
+ * Projects the triangle to the viewport and computes its edge functions a * x + b * y + c (in 1 / 2^SUBPIXEL_BITS
+ * pixels, positive inside once the vertices are counterclockwise), dropping the degenerate ones; pixels on an edge are
+ * drawn only when it is a left or top one, so that a pixel on an edge shared by two triangles is drawn once
+ */
+inline void Rasterizer::setup(const Vertex* v0, const Vertex* v1, const Vertex* v2, vector<Triangle>* out)
+{
+	const Vertex* v[3] = { v0, v1, v2 };
+	const float unit = float(1 << SUBPIXEL_BITS);
+	Triangle triangle;
+	int64_t x[3], y[3];
+	for (int k = 0; k < 3; k++)
+	{
+		float invW = 1.0f / v[k]->position.w;
+		x[k] = int64_t(floor((v[k]->position.x * invW * 0.5f + 0.5f) * width * unit + 0.5f));
+		y[k] = int64_t(floor((v[k]->position.y * invW * 0.5f + 0.5f) * height * unit + 0.5f));
+		triangle.depth[k] = v[k]->position.z * invW * 0.5f + 0.5f;
+		triangle.invW[k] = invW;
+		triangle.color[k] = v[k]->color * invW;
+	}
+
+	int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0)
+		return;
+	if (area < 0)
+	{
+		// no face culling, as in the OpenGL path: clockwise triangles are turned around
+		swap(x[1], x[2]);
+		swap(y[1], y[2]);
+		swap(triangle.depth[1], triangle.depth[2]);
+		swap(triangle.invW[1], triangle.invW[2]);
+		swap(triangle.color[1], triangle.color[2]);
+		area = -area;
+	}
+
+	triangle.minX = std::max(0, int(std::min({ x[0], x[1], x[2] }) >> SUBPIXEL_BITS));
+	triangle.minY = std::max(0, int(std::min({ y[0], y[1], y[2] }) >> SUBPIXEL_BITS));
+	triangle.maxX = std::min(width - 1, int(std::max({ x[0], x[1], x[2] }) >> SUBPIXEL_BITS));
+	triangle.maxY = std::min(height - 1, int(std::max({ y[0], y[1], y[2] }) >> SUBPIXEL_BITS));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	for (int k = 0; k < 3; k++)
+	{
+		int from = (k + 1) % 3, to = (k + 2) % 3;
+		triangle.a[k] = y[from] - y[to];
+		triangle.b[k] = x[to] - x[from];
+		triangle.c[k] = x[from] * y[to] - y[from] * x[to];
+		bool topLeft = triangle.a[k] > 0 || (triangle.a[k] == 0 && triangle.b[k] < 0);
+		if (!topLeft)
+			triangle.c[k]--;
+	}
+	triangle.invArea = 1.0f / float(area);
+	out->push_back(triangle);
+}
+
+/*
+ * Clears the tile and draws its triangles in order, sampling pixel centers
+ */
+inline void Rasterizer::rasterize(size_t tile)
+{
+	int x0 = int(tile % tilesX) * TILE_SIZE, y0 = int(tile / tilesX) * TILE_SIZE;
+	int x1 = std::min(width, x0 + TILE_SIZE), y1 = std::min(height, y0 + TILE_SIZE);
+	for (int y = y0; y < y1; y++)
+	{
+		size_t row = size_t(y) * width;
+		fill(colors.begin() + (row + x0) * 3, colors.begin() + (row + x1) * 3, 0);
+		fill(depths.begin() + row + x0, depths.begin() + row + x1, 1.0f);
+	}
+
+	const int64_t half = 1 << (SUBPIXEL_BITS - 1);
+	for (uint32_t t : bins[tile])
+	{
+		const Triangle& triangle = triangles[t];
+		int left = std::max(x0, triangle.minX), right = std::min(x1 - 1, triangle.maxX);
+		int bottom = std::max(y0, triangle.minY), top = std::min(y1 - 1, triangle.maxY);
+		int64_t step[3];
+		for (int k = 0; k < 3; k++)
+			step[k] = triangle.a[k] << SUBPIXEL_BITS;
+
+		for (int y = bottom; y <= top; y++)
+		{
+			int64_t px = (int64_t(left) << SUBPIXEL_BITS) + half, py = (int64_t(y) << SUBPIXEL_BITS) + half;
+			int64_t e[3];
+			for (int k = 0; k < 3; k++)
+				e[k] = triangle.a[k] * px + triangle.b[k] * py + triangle.c[k];
+
+			size_t row = size_t(y) * width;
+			for (int x = left; x <= right; x++, e[0] += step[0], e[1] += step[1], e[2] += step[2])
+			{
+				if ((e[0] | e[1] | e[2]) < 0)
+					continue;
+
+				float l0 = float(e[0]) * triangle.invArea, l1 = float(e[1]) * triangle.invArea, l2 = float(e[2]) * triangle.invArea;
+				float depth = l0 * triangle.depth[0] + l1 * triangle.depth[1] + l2 * triangle.depth[2];
+				size_t pixel = row + x;
+				if (depth < 0.0f || depth > 1.0f || depth >= depths[pixel])
+					continue;
+
+				depths[pixel] = depth;
+				float invW = l0 * triangle.invW[0] + l1 * triangle.invW[1] + l2 * triangle.invW[2];
+				vec4 color = (l0 * triangle.color[0] + l1 * triangle.color[1] + l2 * triangle.color[2]) / invW;
+				unsigned char* out = colors.data() + pixel * 3;
+				for (int channel = 0; channel < 3; channel++)
+					out[channel] = (unsigned char)(glm::clamp(color[channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	}
+}
+
+/*
+ * Signed distance (scaled by w) of a clip space position from the near plane (0) and the guard band sides (1 to 4)
+ */
+inline float Rasterizer::getDistance(const vec4& position, int plane)
+{
+	switch (plane)
+	{
+	case 0:
+		return position.z + position.w;
+	case 1:
+		return GUARD_BAND * position.w - position.x;
+	case 2:
+		return GUARD_BAND * position.w + position.x;
+	case 3:
+		return GUARD_BAND * position.w - position.y;
+	default:
+		return GUARD_BAND * position.w + position.y;
+	}
+}
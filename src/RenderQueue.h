@@ -0,0 +1,273 @@
+#pragma once
+#include "Utils.h"
+#include "Shape.h"
+#include "Shader.h"
+#include "Global.h"
+#include "Program.h"
+#include "Instances.h"
+#include "Model.h"
+#include "RigidBody.h"
+#include <cstdint>
+#include <unordered_map>
+
+/*
+ * Queue of Draw Items Sorted by State before Submission
+ *
+ * Every item gets a 64-bit key, from the most to the least significant bits:
+ *   pass (4) | shader (8) | material (8) | mesh (20) | depth (24)
+ * where shaders, materials and meshes are numbered in order of first appearance in the frame, and depth is the
+ * distance from the eye (front to back for opaque items, back to front for transparent ones). The keys are radix-sorted
+ * and submit only switches program, material uniforms and VAO when they differ from the previous item's; with an
+ * instanced shader, consecutive items of the same mesh and material go out as one instanced draw.
+ * sortByDepth orders by pass and depth alone, for a depth pre-pass (submitDepth, drawing positions only) or to shade
+ * front to back
+ */
+class RenderQueue
+{
+public:
+	enum Pass { OPAQUE_PASS = 0, TRANSPARENT_PASS = 1 };
+
+	static bool DEPTH_PREPASS;
+	static bool FRONT_TO_BACK;
+
+	RenderQueue();
+
+	RenderQueue* clear();
+	RenderQueue* add(Pass pass, const Material* material, Shape* shape, int subMesh, const mat4& transform);
+	RenderQueue* add(RigidBody* body);
+	RenderQueue* sort();
+	RenderQueue* sortByDepth();
+	RenderQueue* submit();
+	RenderQueue* submitDepth(Shader* depthShader);
+	int getItems();
+	int getStateChanges();
+
+private:
+	struct Item {
+		uint64_t key;
+		Shader* shader;
+		const Material* material;
+		Shape* shape;
+		int subMesh;
+		mat4 model;
+	};
+
+	vector<Item> items;
+	vector<uint32_t> order, scratch;
+	vector<mat4> models;
+	unordered_map<Shader*, uint64_t> shaders;
+	unordered_map<const Material*, uint64_t> materials;
+	unordered_map<Shape*, uint64_t> meshes;
+	int stateChanges;
+
+	void radixSort(bool depthOnly);
+	static uint64_t getSortKey(const Item& item, bool depthOnly);
+	static uint64_t getDepthBits(float depth);
+};
+
+bool RenderQueue::DEPTH_PREPASS = false;
+bool RenderQueue::FRONT_TO_BACK = false;
+
+inline RenderQueue::RenderQueue()
+{
+	stateChanges = 0;
+}
+
+inline RenderQueue* RenderQueue::clear()
+{
+	items.clear();
+	shaders.clear();
+	materials.clear();
+	meshes.clear();
+	return this;
+}
+
+/*
+ * Queues a draw of the sub-mesh (all of them when negative) of the shape with the current shader and model matrix,
+ * multiplied by the given one
+ */
+inline RenderQueue* RenderQueue::add(Pass pass, const Material* material, Shape* shape, int subMesh, const mat4& transform)
+{
+	mat4 model = Program::getModel()->getMatrix() * transform;
+	Shader* shader = Program::getShader();
+	uint64_t shaderId = shaders.insert({ shader, shaders.size() }).first->second;
+	uint64_t materialId = materials.insert({ material, materials.size() }).first->second;
+	uint64_t meshId = meshes.insert({ shape, meshes.size() }).first->second;
+
+	vec3 eye = Program::getView()->getPosition();
+	vec3 position = vec3(model[3].x, model[3].y, model[3].z);
+	uint64_t depth = getDepthBits(length(position - eye));
+	if (pass == TRANSPARENT_PASS)
+		depth = 0xFFFFFF - depth;
+
+	uint64_t key = (uint64_t(pass) & 0xF) << 60 | (shaderId & 0xFF) << 52 | (materialId & 0xFF) << 44 | (meshId & 0xFFFFF) << 24 | depth;
+	items.push_back({ key, shader, material, shape, subMesh, model });
+	return this;
+}
+
+/*
+ * Queues the shape of the body at its level of detail, as an opaque draw with the body material
+ */
+inline RenderQueue* RenderQueue::add(RigidBody* body)
+{
+	if (body->getShape() == NULL)
+		return this;
+
+	const Material* m = body->isSelected() ? &World::SELECTED_MATERIAL : &World::DEFAULT_MATERIAL;
+	return add(OPAQUE_PASS, m, body->getShape(), body->selectLevel(), body->getTransform());
+}
+
+inline RenderQueue* RenderQueue::sort()
+{
+	radixSort(false);
+	return this;
+}
+
+inline RenderQueue* RenderQueue::sortByDepth()
+{
+	radixSort(true);
+	return this;
+}
+
+/*
+ * LSD radix sort of the item order, one byte per pass, skipping the bytes every key shares
+ */
+inline void RenderQueue::radixSort(bool depthOnly)
+{
+	order.resize(items.size());
+	scratch.resize(items.size());
+	for (uint32_t i = 0; i < items.size(); i++)
+		order[i] = i;
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t counts[257] = {};
+		for (uint32_t i : order)
+			counts[((getSortKey(items[i], depthOnly) >> shift) & 0xFF) + 1]++;
+		if (*std::max_element(counts + 1, counts + 257) == items.size())
+			continue;
+
+		for (int b = 0; b < 256; b++)
+			counts[b + 1] += counts[b];
+		for (uint32_t i : order)
+			scratch[counts[(getSortKey(items[i], depthOnly) >> shift) & 0xFF]++] = i;
+		order.swap(scratch);
+	}
+}
+
+/*
+ * Draws the items in the last sorted order (sort or sortByDepth must have been called after the last add)
+ */
+inline RenderQueue* RenderQueue::submit()
+{
+	Shader* shader = NULL;
+	const Material* material = NULL;
+	Shape* shape = NULL;
+	stateChanges = 0;
+	for (size_t o = 0; o < order.size(); o++)
+	{
+		Item& item = items[order[o]];
+		if (item.shader != shader)
+		{
+			shader = item.shader;
+			material = NULL;
+			shape = NULL;
+			glUseProgram(shader->getProgramId());
+			stateChanges++;
+		}
+		if (item.material != material)
+		{
+			material = item.material;
+			shader->setUniformFloat(Shaders::SHININESS_VARIABLE, material->shininess)
+				->setUniformVec3(Shaders::AMBIENT_PRODUCT_VARIABLE, World::DEFAULT_LIGHT.ambient * material->ambient)
+				->setUniformVec3(Shaders::DIFFUSE_PRODUCT_VARIABLE, World::DEFAULT_LIGHT.diffuse * material->diffuse)
+				->setUniformVec3(Shaders::SPECULAR_PRODUCT_VARIABLE, World::DEFAULT_LIGHT.specular * material->specular);
+			stateChanges++;
+		}
+		if (item.shape != shape)
+		{
+			shape = item.shape;
+			shape->bind(shader);
+			stateChanges++;
+		}
+		if (!shader->usesAttribute(Instances::ATTRIBUTE))
+		{
+			Instances::push(item.model);
+			shape->drawBound(item.subMesh);
+			continue;
+		}
+
+		models.assign(1, item.model);
+		for (; o + 1 < order.size(); o++)
+		{
+			Item& next = items[order[o + 1]];
+			if (next.shader != shader || next.material != material || next.shape != shape || next.subMesh != item.subMesh)
+				break;
+			models.push_back(next.model);
+		}
+		Instances::push(models);
+		Instances::bindAttributes();
+		shape->drawBound(item.subMesh, models.size());
+	}
+	glBindVertexArray(0);
+	if (shader != NULL && shader != Program::getShader())
+		glUseProgram(Program::getShader()->getProgramId());
+	return this;
+}
+
+/*
+ * Draws the positions of the items in the last sorted order with the depth shader, colors masked out, so that a
+ * following submit with GL_EQUAL depth test shades each pixel once (both vertex shaders must declare gl_Position invariant)
+ */
+inline RenderQueue* RenderQueue::submitDepth(Shader* depthShader)
+{
+	glUseProgram(depthShader->getProgramId());
+	depthShader->setUniformMat4(Shaders::VIEW_VARIABLE, Program::getView()->getMatrix())
+		->setUniformMat4(Shaders::PROJECTION_VARIABLE, Program::getProjection()->getMatrix());
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	Shape* shape = NULL;
+	for (uint32_t i : order)
+	{
+		Item& item = items[i];
+		if (item.shape != shape)
+		{
+			shape = item.shape;
+			shape->bind(depthShader);
+		}
+		Instances::push(item.model);
+		shape->drawBound(item.subMesh);
+	}
+	glBindVertexArray(0);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glUseProgram(Program::getShader()->getProgramId());
+	return this;
+}
+
+inline int RenderQueue::getItems()
+{
+	return items.size();
+}
+
+/*
+ * Program, material and VAO switches of the last submit
+ */
+inline int RenderQueue::getStateChanges()
+{
+	return stateChanges;
+}
+
+inline uint64_t RenderQueue::getSortKey(const Item& item, bool depthOnly)
+{
+	return depthOnly ? (item.key >> 60) << 24 | (item.key & 0xFFFFFF) : item.key;
+}
+
+/*
+ * The bits of a non-negative float grow with its value, so their top 24 bits order depths with no scaling
+ */
+inline uint64_t RenderQueue::getDepthBits(float depth)
+{
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return (depth > 0.0f ? bits : 0) >> 8;
+}
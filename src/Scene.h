@@ -0,0 +1,111 @@
+#pragma once
+#include "Utils.h"
+#include "Shapes.h"
+#include "RigidBody.h"
+#include <fstream>
+#include <sstream>
+
+/*
+ * Loader for Plain-Text Scene Files
+ *
+ * Each non-empty line not starting with '#' describes a body:
+ *   <shape> <px> <py> <pz> [<sx> <sy> <sz> [<ax> <ay> <az>]] [static]
+ * where <shape> is one of plane, cube, pyramid, sphere, cilinder, cone, torus, and static bodies are merged into the StaticBatch
+ * (tessellated shapes are shared LOD chains, so Shapes::initDefault must have been called), or a light:
+ *   light <px> <py> <pz> <r> <g> <b> <radius> [<dx> <dy> <dz> <angle>]
+ * a spot light when a direction and the cone half-angle (in degrees) are given; lights are skipped when no list is passed
+ */
+class Scene
+{
+public:
+	static const string SHAPE_NAMES[];
+
+	static void load(string filename, vector<RigidBody*>* bodies, vector<PointLight>* lights = NULL);
+	static Shape* createShape(string name);
+
+private:
+	Scene();
+
+	static PointLight readLight(istringstream* stream);
+};
+
+const string Scene::SHAPE_NAMES[] = { "plane", "cube", "pyramid", "sphere", "cilinder", "cone", "torus" };
+
+inline void Scene::load(string filename, vector<RigidBody*>* bodies, vector<PointLight>* lights)
+{
+	ifstream file(filename);
+	if (!file)
+		throw "cannot open scene file";
+
+	string line;
+	while (getline(file, line))
+	{
+		istringstream stream(line);
+		string name;
+		if (!(stream >> name) || name[0] == '#')
+			continue;
+		if (name == "light")
+		{
+			PointLight light = readLight(&stream);
+			if (lights != NULL)
+				lights->push_back(light);
+			continue;
+		}
+
+		double x, y, z;
+		Point position;
+		Vector scale(1.0, 1.0, 1.0), angles;
+		if (!(stream >> x >> y >> z))
+			throw "malformed scene file";
+		position = { x, y, z };
+		if (stream >> x >> y >> z)
+			scale = { x, y, z };
+		if (stream >> x >> y >> z)
+			angles = { x, y, z };
+
+		string flag;
+		stream.clear();
+		if (stream >> flag && flag != "static")
+			throw "malformed scene file";
+
+		RigidBody* body = new RigidBody(createShape(name));
+		body->setPosition(position)->setScale(scale)->setAngles(angles)->setStatic(flag == "static");
+		bodies->push_back(body);
+	}
+}
+
+inline Shape* Scene::createShape(string name)
+{
+	for (char& c : name)
+		c = tolower(c);
+
+	if (name == SHAPE_NAMES[PLANE])
+		return Shapes::plane();
+	if (name == SHAPE_NAMES[CUBE])
+		return Shapes::cube();
+	if (name == SHAPE_NAMES[PYRAMID])
+		return Shapes::pyramid();
+	if (name == SHAPE_NAMES[SPHERE])
+		return Shapes::SPHERE;
+	if (name == SHAPE_NAMES[CILINDER])
+		return Shapes::CILINDER;
+	if (name == SHAPE_NAMES[CONE])
+		return Shapes::CONE;
+	if (name == SHAPE_NAMES[TORUS])
+		return Shapes::TORUS;
+	throw "Unknow Shape";
+}
+
+inline PointLight Scene::readLight(istringstream* stream)
+{
+	PointLight light;
+	if (!(*stream >> light.position.x >> light.position.y >> light.position.z >> light.color.x >> light.color.y >> light.color.z >> light.radius))
+		throw "malformed scene file";
+
+	float angle;
+	if (*stream >> light.direction.x >> light.direction.y >> light.direction.z >> angle)
+		light.cutoff = cos(radians(angle));
+	else
+		light.direction = vec3(0.0f, -1.0f, 0.0f);
+	return light;
+}
\ No newline at end of file
@@ -1,10 +1,10 @@
-#pragma once
-#include "Utils.h"
-
-/*
- * Represents a body selector
- */
-class Model
-{
-public:
+#pragma once
+#include "Utils.h"
+
+/*
+ * Represents a body selector
+ */
+class Model
+{
+public:
 	static const mat4 IDENTITY;
\ No newline at end of file
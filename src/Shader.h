@@ -1,130 +1,513 @@
-#pragma once
-#include "Utils.h"
-#include <list>
-#include <map>
-
-/*
- * Manager for the Vertex/Fragment Shaders
- */
-class Shader
-{
-public:
-	Shader();
-	~Shader();
-
-	Shader* addShader(GLenum shaderType, string shaderFile);
-	Shader* updateProgram();
-	GLuint getProgramId();
-
-	Shader* setVariableLocation(string name);
-	Shader* setUniformFloat(string name, GLfloat value);
-	Shader* setUniformVec4(string name, vec4 vector);
-	Shader* setUniformVec3(string name, vec3 vector);
-	Shader* setUniformMat4(string name, mat4 matrix);
-
-private:
-	GLuint programId;
-	list<GLuint> shaders;
-	map<string, GLuint> variables;
-
-	char* readSource(string shaderFile);
-	GLuint getLocationOrThrow(string name);
-};
-
-Shader::Shader()
-{
-	programId = glCreateProgram();
-	glLinkProgram(programId);
-	glUseProgram(programId);
-}
-
-inline Shader::~Shader()
-{
-	glDeleteProgram(programId);
-}
-
-inline Shader* Shader::addShader(GLenum shaderType, string shaderFile)
-{
-	GLuint shaderId = glCreateShader(shaderType);
-	const char* shaderSource = readSource(shaderFile);
-	glShaderSource(shaderId, 1, &shaderSource, NULL);
-	glCompileShader(shaderId);
-	delete shaderSource;
-
-	shaders.push_back(shaderId);
-	return this;
-}
-
-inline Shader* Shader::updateProgram()
-{
-	glDeleteProgram(programId);
-	programId = glCreateProgram();
-	for(GLuint shaderId : shaders) {
-		glAttachShader(programId, shaderId);
-	}
-	glLinkProgram(programId);
-	glUseProgram(programId);
-	return this;
-}
-
-inline GLuint Shader::getProgramId()
-{
-	return this->programId;
-}
-
-inline Shader* Shader::setVariableLocation(string name)
-{
-	variables.insert({ name, glGetUniformLocation(getProgramId(), name.c_str()) });
-	return this;
-}
-
-inline Shader* Shader::setUniformFloat(string name, GLfloat value)
-{
-	glUniform1f(getLocationOrThrow(name), value);
-	return this;
-}
-
-inline Shader* Shader::setUniformVec3(string name, vec3 vector)
-{
-	glUniform3f(getLocationOrThrow(name), vector.x, vector.y, vector.z);
-	return this;
-}
-
-inline Shader* Shader::setUniformVec4(string name, vec4 vector)
-{
-	glUniform4f(getLocationOrThrow(name), vector.x, vector.y, vector.z, vector.w);
-	return this;
-}
-
-inline Shader* Shader::setUniformMat4(string name, mat4 matrix)
-{
-	glUniformMatrix4fv(getLocationOrThrow(name), 1, GL_FALSE, value_ptr(matrix));
-	return this;
-}
-
-inline GLuint Shader::getLocationOrThrow(string name)
-{
-	map<string, GLuint>::iterator iterator = variables.find(name);
-	return (iterator == variables.end()) ? throw "nonexistent variable" : iterator->second;
-}
-
-inline char* Shader::readSource(string shaderFile)
-{
-	FILE* file;
-	char* buffer;
-	long size;
-
-	fopen_s(&file, shaderFile.c_str(), "rb");
-	if (file == NULL)
-		return NULL;
-
-	fseek(file, 0L, SEEK_END);
-	size = ftell(file);
-	fseek(file, 0L, SEEK_SET);
-	buffer = new char[size + 1];
-	fread(buffer, 1, size, file);
-	buffer[size] = '\0';
-	fclose(file);
-
-	return buffer;
-}
+#pragma once
+#include "Utils.h"
+#include <list>
+#include <map>
+#include <fstream>
+#include <cstdint>
+
+/*
+ * Manager for the Vertex/Fragment Shaders
+ *
+ * Linked programs are cached on disk (ARB_get_program_binary) in a file named after a hash of the driver string and of
+ * the sources of every stage, and loaded back with glProgramBinary; a binary the driver rejects is compiled again from
+ * source and overwritten. Compile and link errors are printed with their log and thrown.
+ * Defines are inserted after the #version line of every stage, so each set of them is a separate program (and cache file).
+ * reload reads the stages again and builds the new program in the background (KHR/ARB_parallel_shader_compile) while
+ * the old one stays in use: poll swaps them once the new one is linked, and keeps the old one if it fails
+ */
+class Shader
+{
+public:
+	static const string CACHE_PREFIX;
+	static bool CACHE;
+
+	static bool isCacheSupported();
+	static bool isParallelSupported();
+
+	Shader();
+	~Shader();
+
+	Shader* addShader(GLenum shaderType, string shaderFile);
+	Shader* addDefine(string name, string value = "");
+	Shader* updateProgram();
+	Shader* reload();
+	bool poll();
+	bool isUpdating();
+	GLuint getProgramId();
+	bool isCached();
+	bool usesAttribute(GLuint location);
+
+	Shader* setVariableLocation(string name);
+	Shader* setUniformFloat(string name, GLfloat value);
+	Shader* setUniformVec4(string name, vec4 vector);
+	Shader* setUniformVec3(string name, vec3 vector);
+	Shader* setUniformMat3(string name, mat3 matrix);
+	Shader* setUniformMat4(string name, mat4 matrix);
+
+private:
+	struct Stage {
+		GLenum type;
+		string file;
+		string source;
+	};
+
+	GLuint programId;
+	GLuint pendingId;
+	vector<GLuint> pendingShaders;
+	string pendingCacheFile;
+	bool pendingCached;
+	list<Stage> stages;
+	string defines;
+	map<string, GLuint> variables;
+	unsigned int attributes;
+	bool cached;
+
+	void startUpdate();
+	const char* finishUpdate(bool use);
+	void discardPending();
+	void findAttributes();
+	string getSource(const Stage& stage);
+	bool loadBinary(GLuint* program, string cacheFile);
+	void saveBinary(GLuint program, string cacheFile);
+	string getCacheFile();
+	char* readSource(string shaderFile);
+	GLuint getLocationOrThrow(string name);
+	static int parallel;
+
+	static string getLog(GLuint id, bool isProgram);
+};
+
+const string Shader::CACHE_PREFIX = "ShaderCache-";
+bool Shader::CACHE = true;
+int Shader::parallel = -1;
+
+inline bool Shader::isCacheSupported()
+{
+	GLint formats = 0;
+	if (GLEW_ARB_get_program_binary)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+/*
+ * The first call also lets the driver use as many compiler threads as it wants
+ */
+inline bool Shader::isParallelSupported()
+{
+	if (parallel < 0)
+	{
+		parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+		if (GLEW_KHR_parallel_shader_compile)
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		else if (GLEW_ARB_parallel_shader_compile)
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	}
+	return parallel != 0;
+}
+
+Shader::Shader()
+{
+	pendingId = 0;
+	pendingCached = false;
+	cached = false;
+	attributes = 0;
+	programId = glCreateProgram();
+	glLinkProgram(programId);
+	glUseProgram(programId);
+}
+
+inline Shader::~Shader()
+{
+	discardPending();
+	glDeleteProgram(programId);
+}
+
+/*
+ * Only reads the source, stages are compiled by updateProgram when the cache misses
+ */
+inline Shader* Shader::addShader(GLenum shaderType, string shaderFile)
+{
+	char* shaderSource = readSource(shaderFile);
+	if (shaderSource == NULL)
+		throw "cannot open shader file";
+	stages.push_back({ shaderType, shaderFile, shaderSource });
+	delete[] shaderSource;
+	return this;
+}
+
+/*
+ * Takes effect at the next updateProgram
+ */
+inline Shader* Shader::addDefine(string name, string value)
+{
+	defines += "#define " + name + " " + value + "\n";
+	return this;
+}
+
+/*
+ * Creates the program again, from the cache if possible, waiting for it to link
+ */
+inline Shader* Shader::updateProgram()
+{
+	startUpdate();
+	const char* error = finishUpdate(true);
+	if (error != NULL)
+		throw error;
+	return this;
+}
+
+/*
+ * Reads the stages again and starts building them, unless a file cannot be read (while an editor replaces it, say)
+ */
+inline Shader* Shader::reload()
+{
+	vector<string> sources;
+	for (Stage& stage : stages)
+	{
+		char* source = readSource(stage.file);
+		if (source == NULL)
+			return this;
+		sources.push_back(source);
+		delete[] source;
+	}
+
+	int i = 0;
+	for (Stage& stage : stages)
+		stage.source = sources[i++];
+	startUpdate();
+	return this;
+}
+
+/*
+ * Swaps in the program started by reload once the driver has finished it, and tells whether it did;
+ * errors are printed and the current program kept
+ */
+inline bool Shader::poll()
+{
+	if (pendingId == 0)
+		return false;
+
+	GLint completed = GL_TRUE;
+	if (isParallelSupported())
+		glGetProgramiv(pendingId, GL_COMPLETION_STATUS_KHR, &completed);
+	if (completed == GL_FALSE)
+		return false;
+
+	const char* error = finishUpdate(false);
+	if (error != NULL)
+		cout << error << ", keeping the previous program" << endl;
+	return error == NULL;
+}
+
+inline bool Shader::isUpdating()
+{
+	return pendingId != 0;
+}
+
+inline GLuint Shader::getProgramId()
+{
+	return this->programId;
+}
+
+/*
+ * Whether the current program was loaded from the cache instead of compiled
+ */
+inline bool Shader::isCached()
+{
+	return cached;
+}
+
+inline Shader* Shader::setVariableLocation(string name)
+{
+	variables.insert({ name, glGetUniformLocation(getProgramId(), name.c_str()) });
+	return this;
+}
+
+inline Shader* Shader::setUniformFloat(string name, GLfloat value)
+{
+	glUniform1f(getLocationOrThrow(name), value);
+	return this;
+}
+
+inline Shader* Shader::setUniformVec3(string name, vec3 vector)
+{
+	glUniform3f(getLocationOrThrow(name), vector.x, vector.y, vector.z);
+	return this;
+}
+
+inline Shader* Shader::setUniformVec4(string name, vec4 vector)
+{
+	glUniform4f(getLocationOrThrow(name), vector.x, vector.y, vector.z, vector.w);
+	return this;
+}
+
+inline Shader* Shader::setUniformMat3(string name, mat3 matrix)
+{
+	glUniformMatrix3fv(getLocationOrThrow(name), 1, GL_FALSE, value_ptr(matrix));
+	return this;
+}
+
+inline Shader* Shader::setUniformMat4(string name, mat4 matrix)
+{
+	glUniformMatrix4fv(getLocationOrThrow(name), 1, GL_FALSE, value_ptr(matrix));
+	return this;
+}
+
+inline GLuint Shader::getLocationOrThrow(string name)
+{
+	map<string, GLuint>::iterator iterator = variables.find(name);
+	return (iterator == variables.end()) ? throw "nonexistent variable" : iterator->second;
+}
+
+/*
+ * Whether the vertex attribute at the location is active in the linked program (so its array must be enabled)
+ */
+inline bool Shader::usesAttribute(GLuint location)
+{
+	return location < 32 && (attributes >> location & 1) != 0;
+}
+
+/*
+ * Loads the pending program from the cache or issues its compilation and link, querying no status, so that with
+ * parallel compilation the driver returns at once
+ */
+inline void Shader::startUpdate()
+{
+	discardPending();
+	isParallelSupported();
+	pendingId = glCreateProgram();
+	bool useCache = CACHE && isCacheSupported();
+	pendingCacheFile = useCache ? getCacheFile() : "";
+	pendingCached = useCache && loadBinary(&pendingId, pendingCacheFile);
+	if (pendingCached)
+		return;
+
+	for (Stage& stage : stages)
+	{
+		GLuint shaderId = glCreateShader(stage.type);
+		string source = getSource(stage);
+		const char* shaderSource = source.c_str();
+		glShaderSource(shaderId, 1, &shaderSource, NULL);
+		glCompileShader(shaderId);
+		glAttachShader(pendingId, shaderId);
+		pendingShaders.push_back(shaderId);
+	}
+	if (useCache)
+		glProgramParameteri(pendingId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(pendingId);
+}
+
+/*
+ * Checks the pending stages and program (blocking if not completed yet) and, if they built, replaces the current
+ * program, made current when use is set or when the replaced one was; returns the error otherwise
+ */
+inline const char* Shader::finishUpdate(bool use)
+{
+	const char* error = NULL;
+	list<Stage>::iterator stage = stages.begin();
+	for (GLuint shaderId : pendingShaders)
+	{
+		GLint status;
+		glGetShaderiv(shaderId, GL_COMPILE_STATUS, &status);
+		if (status == GL_FALSE)
+		{
+			cout << stage->file << ":" << endl << getLog(shaderId, false) << endl;
+			error = "cannot compile shader";
+		}
+		stage++;
+	}
+	GLint status;
+	glGetProgramiv(pendingId, GL_LINK_STATUS, &status);
+	if (error == NULL && status == GL_FALSE)
+	{
+		cout << getLog(pendingId, true) << endl;
+		error = "cannot link shader program";
+	}
+	if (error != NULL)
+	{
+		discardPending();
+		return error;
+	}
+
+	for (GLuint shaderId : pendingShaders)
+	{
+		glDetachShader(pendingId, shaderId);
+		glDeleteShader(shaderId);
+	}
+	pendingShaders.clear();
+	if (!pendingCached && !pendingCacheFile.empty())
+		saveBinary(pendingId, pendingCacheFile);
+
+	GLint current = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+	if (use || GLuint(current) == programId)
+		glUseProgram(pendingId);
+	glDeleteProgram(programId);
+	programId = pendingId;
+	pendingId = 0;
+	cached = pendingCached;
+	findAttributes();
+
+	for (pair<const string, GLuint>& variable : variables)
+		variable.second = glGetUniformLocation(programId, variable.first.c_str());
+	return NULL;
+}
+
+inline void Shader::discardPending()
+{
+	for (GLuint shaderId : pendingShaders)
+		glDeleteShader(shaderId);
+	pendingShaders.clear();
+	if (pendingId != 0)
+		glDeleteProgram(pendingId);
+	pendingId = 0;
+}
+
+/*
+ * The file holds the binary format followed by the binary; a missing file or a binary rejected by the driver
+ * (after an update, for instance) is a miss
+ */
+inline bool Shader::loadBinary(GLuint* program, string cacheFile)
+{
+	ifstream file(cacheFile, ios::binary);
+	if (!file)
+		return false;
+
+	GLenum format;
+	file.read((char*)&format, sizeof(format));
+	if (!file)
+		return false;
+	vector<char> binary((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	if (binary.empty())
+		return false;
+
+	glProgramBinary(*program, format, binary.data(), binary.size());
+	GLint status;
+	glGetProgramiv(*program, GL_LINK_STATUS, &status);
+	if (status == GL_TRUE)
+		return true;
+
+	glDeleteProgram(*program);
+	*program = glCreateProgram();
+	return false;
+}
+
+/*
+ * Failing to write the cache only costs a compilation at the next launch
+ */
+inline void Shader::saveBinary(GLuint program, string cacheFile)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	GLenum format;
+	vector<char> binary(length);
+	glGetProgramBinary(program, length, NULL, &format, binary.data());
+	ofstream file(cacheFile, ios::binary);
+	if (!file)
+		return;
+	file.write((const char*)&format, sizeof(format));
+	file.write(binary.data(), binary.size());
+}
+
+/*
+ * 64-bit FNV-1a of vendor, renderer and version strings and of the type and source of every stage
+ */
+inline string Shader::getCacheFile()
+{
+	uint64_t hash = 14695981039346656037ULL;
+	function<void(const string&)> add = [&hash](const string& text) {
+		for (unsigned char c : text)
+			hash = (hash ^ c) * 1099511628211ULL;
+		hash = (hash ^ 0xFF) * 1099511628211ULL;
+	};
+
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const GLubyte* driver = glGetString(name);
+		add(driver != NULL ? string((const char*)driver) : "");
+	}
+	for (Stage& stage : stages)
+	{
+		add(to_string(stage.type));
+		add(getSource(stage));
+	}
+
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+	return CACHE_PREFIX + name + ".bin";
+}
+
+/*
+ * A matrix attribute takes one location per column
+ */
+inline void Shader::findAttributes()
+{
+	attributes = 0;
+	GLint count = 0, length = 0;
+	glGetProgramiv(programId, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(programId, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &length);
+	vector<char> name(std::max(length, 1));
+	for (GLint i = 0; i < count; i++)
+	{
+		GLint size;
+		GLenum type;
+		glGetActiveAttrib(programId, i, name.size(), NULL, &size, &type, name.data());
+		GLint location = glGetAttribLocation(programId, name.data());
+		int columns = (type == GL_FLOAT_MAT4 || type == GL_DOUBLE_MAT4) ? 4 : (type == GL_FLOAT_MAT3 || type == GL_DOUBLE_MAT3) ? 3 : 1;
+		for (int c = 0; location >= 0 && c < columns * size; c++)
+			if (location + c < 32)
+				attributes |= 1u << (location + c);
+	}
+}
+
+inline string Shader::getSource(const Stage& stage)
+{
+	if (defines.empty() || stage.source.compare(0, 8, "#version") != 0)
+		return defines + stage.source;
+	size_t line = stage.source.find('\n');
+	if (line == string::npos)
+		return stage.source + "\n" + defines;
+	return stage.source.substr(0, line + 1) + defines + stage.source.substr(line + 1);
+}
+
+inline string Shader::getLog(GLuint id, bool isProgram)
+{
+	GLint length = 0;
+	if (isProgram)
+		glGetProgramiv(id, GL_INFO_LOG_LENGTH, &length);
+	else
+		glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+	if (length <= 0)
+		return "";
+
+	vector<char> log(length);
+	if (isProgram)
+		glGetProgramInfoLog(id, length, NULL, log.data());
+	else
+		glGetShaderInfoLog(id, length, NULL, log.data());
+	return string(log.data());
+}
+
+inline char* Shader::readSource(string shaderFile)
+{
+	FILE* file;
+	char* buffer;
+	long size;
+
+	file = fopen(shaderFile.c_str(), "rb");
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0L, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0L, SEEK_SET);
+	buffer = new char[size + 1];
+	fread(buffer, 1, size, file);
+	buffer[size] = '\0';
+	fclose(file);
+
+	return buffer;
+}
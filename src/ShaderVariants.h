@@ -0,0 +1,131 @@
+#pragma once
+#include "Utils.h"
+#include "Shader.h"
+#include "Global.h"
+#include <map>
+
+/*
+ * Variants of a Vertex/Fragment Shader Pair Built from Feature Defines
+ *
+ * Each combination of features and light count is compiled (or loaded from the Shader cache) the first time it is
+ * requested and kept until the manager is deleted. Vertex colors are only read by the VERTEX_COLORS variants, and
+ * Shape::bind leaves their array disabled for the others; INSTANCED variants read the model and normal matrices from
+ * the per-instance attributes of Instances, so that RenderQueue draws the repeats of a mesh with one call. A variant
+ * has room for its light count, the positions set through the LIGHT_POSITION_VARIABLE + "[i]" uniforms and the lights
+ * used through LIGHT_COUNT_VARIABLE (a float, not over the light count); CLUSTERED variants (always per pixel) keep only
+ * the first of them, at the eye, and add the lights of the fragment cluster, read from the LightClusters buffers.
+ * reload rebuilds every variant in the background from the files as they are now, and poll swaps each one in as soon
+ * as it is linked
+ */
+class ShaderVariants
+{
+public:
+	enum Feature { PER_PIXEL = 1, VERTEX_COLORS = 2, INSTANCED = 4, CLUSTERED = 8 };
+
+	static const int MAX_LIGHTS;
+	static unsigned int FEATURES;
+	static int LIGHTS;
+
+	ShaderVariants(string vertexFile, string fragmentFile);
+	~ShaderVariants();
+
+	Shader* get(unsigned int features, int lights = 1);
+	int getVariants();
+	void reload();
+	bool poll();
+	vector<string> getFiles();
+
+private:
+	string vertexFile;
+	string fragmentFile;
+	map<unsigned int, Shader*> variants;
+
+	Shader* build(unsigned int features, int lights);
+};
+
+const int ShaderVariants::MAX_LIGHTS = 8;
+unsigned int ShaderVariants::FEATURES = 0;
+int ShaderVariants::LIGHTS = 1;
+
+inline ShaderVariants::ShaderVariants(string vertexFile, string fragmentFile)
+{
+	this->vertexFile = vertexFile;
+	this->fragmentFile = fragmentFile;
+}
+
+inline ShaderVariants::~ShaderVariants()
+{
+	for (pair<const unsigned int, Shader*>& variant : variants)
+		delete variant.second;
+}
+
+inline Shader* ShaderVariants::get(unsigned int features, int lights)
+{
+	if (lights < 1 || lights > MAX_LIGHTS)
+		throw "unsupported light count";
+
+	unsigned int key = features | lights << 8;
+	map<unsigned int, Shader*>::iterator variant = variants.find(key);
+	if (variant != variants.end())
+		return variant->second;
+	return variants[key] = build(features, lights);
+}
+
+inline int ShaderVariants::getVariants()
+{
+	return variants.size();
+}
+
+inline void ShaderVariants::reload()
+{
+	for (pair<const unsigned int, Shader*>& variant : variants)
+		variant.second->reload();
+}
+
+/*
+ * Whether any variant was swapped
+ */
+inline bool ShaderVariants::poll()
+{
+	bool swapped = false;
+	for (pair<const unsigned int, Shader*>& variant : variants)
+		swapped = variant.second->poll() || swapped;
+	return swapped;
+}
+
+inline vector<string> ShaderVariants::getFiles()
+{
+	return { vertexFile, fragmentFile };
+}
+
+inline Shader* ShaderVariants::build(unsigned int features, int lights)
+{
+	Shader* shader = new Shader();
+	if (features & (PER_PIXEL | CLUSTERED))
+		shader->addDefine("PER_PIXEL");
+	if (features & CLUSTERED)
+		shader->addDefine("CLUSTERED");
+	if (features & VERTEX_COLORS)
+		shader->addDefine("VERTEX_COLORS");
+	if (features & INSTANCED)
+		shader->addDefine("INSTANCED");
+	shader->addDefine("LIGHTS", to_string(lights));
+
+	shader->addShader(GL_VERTEX_SHADER, vertexFile)
+		->addShader(GL_FRAGMENT_SHADER, fragmentFile)->updateProgram()
+		->setVariableLocation(Shaders::TIME_VARIABLE)
+		->setVariableLocation(Shaders::VIEW_VARIABLE)
+		->setVariableLocation(Shaders::PROJECTION_VARIABLE)
+		->setVariableLocation(Shaders::SHININESS_VARIABLE)
+		->setVariableLocation(Shaders::EYE_POSITION_VARIABLE)
+		->setVariableLocation(Shaders::LIGHT_POSITION_VARIABLE)
+		->setVariableLocation(Shaders::LIGHT_COUNT_VARIABLE)
+		->setVariableLocation(Shaders::AMBIENT_PRODUCT_VARIABLE)
+		->setVariableLocation(Shaders::DIFFUSE_PRODUCT_VARIABLE)
+		->setVariableLocation(Shaders::SPECULAR_PRODUCT_VARIABLE);
+	if (features & CLUSTERED)
+		shader->setVariableLocation(Shaders::CLUSTER_SCALE_VARIABLE)->setVariableLocation(Shaders::CLUSTER_GRID_VARIABLE);
+	for (int i = 1; i < lights; i++)
+		shader->setVariableLocation(Shaders::LIGHT_POSITION_VARIABLE + "[" + to_string(i) + "]");
+	return shader;
+}
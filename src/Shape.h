@@ -1,165 +1,599 @@
-#pragma once
-#include "Utils.h"
-#include "Program.h"
-
-/*
- * Generic 3D Shape
- */
-class Shape
-{
-public:
-	Shape();
-	Shape(vector<Point> v, vector<Point> n, vector<Index> i);
-	Shape(vector<Point> v, vector<Color> c, vector<Index> i);
-	Shape(vector<Point> v, vector<Point> n, vector<Color> c, vector<Index> i);
-	virtual ~Shape();
-	virtual void draw();
-	virtual void draw(function<void()> &uniformVariableRoutine);
-
-	virtual void updateVAO();
-	virtual vector<Point>* getVertices();
-	virtual vector<Point>* getNormals();
-	virtual vector<Color>* getColors();
-	virtual vector<Index>* getIndices();
-
-private:
-	GLuint shapeVAO;
-	GLuint verticesVBO, normalsVBO, colorsVBO, indicesVBO;
-	vector<Point> vertices;
-	vector<Point> normals;
-	vector<Color> colors;
-	vector<Index> indices;
-
-	void createVAO();
-	void deleteVAO();
-};
-
-Shape::Shape() { }
-
-Shape::Shape(vector<Point> v, vector<Point> n, vector<Index> i)
-{
-	vertices.insert(vertices.end(), v.begin(), v.end());
-	normals.insert(normals.end(), n.begin(), n.end());
-	indices.insert(indices.end(), i.begin(), i.end());
-
-	for (unsigned int i = 0; i < v.size(); i++)
-	{
-		colors.push_back({ 1.0, 1.0, 1.0, 0.0 });
-	}
-
-	createVAO();
-}
-
-Shape::Shape(vector<Point> v, vector<Color> c, vector<Index> i)
-{
-	vertices.insert(vertices.end(), v.begin(), v.end());
-	colors.insert(colors.end(), c.begin(), c.end());
-	indices.insert(indices.end(), i.begin(), i.end());
-
-	for (unsigned int i = 0; i < v.size(); i++) 
-	{
-		normals.push_back({ 0.0, 0.0, 0.0 });
-	}
-
-	createVAO();
-}
-
-inline Shape::Shape(vector<Point> v, vector<Point> n, vector<Color> c, vector<Index> i)
-{
-	vertices.insert(vertices.end(), v.begin(), v.end());
-	normals.insert(normals.end(), n.begin(), n.end());
-	colors.insert(colors.end(), c.begin(), c.end());
-	indices.insert(indices.end(), i.begin(), i.end());
-
-	createVAO();
-}
-
-Shape::~Shape()
-{
-	deleteVAO();
-}
-
-inline void Shape::draw()
-{
-	function<void()> routine = Shaders::DEFAULT_UNIFORM_VARIABLES_ROUTINE;
-	draw(routine);
-}
-
-inline void Shape::draw(function<void()>& uniformVariableRoutine)
-{
-	uniformVariableRoutine();
-	glBindVertexArray(shapeVAO);
-	glDrawElements(GL_TRIANGLES, indices.size() * sizeof(Index), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
-}
-
-inline void Shape::updateVAO()
-{
-	deleteVAO();
-	createVAO();
-}
-
-inline vector<Point>* Shape::getVertices()
-{
-	return &vertices;
-}
-
-inline vector<Point>* Shape::getNormals()
-{
-	return &normals;
-}
-
-inline vector<Color>* Shape::getColors()
-{
-	return &colors;
-}
-
-inline vector<Index>* Shape::getIndices()
-{
-	return &indices;
-}
-
-inline void Shape::createVAO()
-{
-	glGenVertexArrays(1, &shapeVAO);
-	glBindVertexArray(shapeVAO);
-
-	glGenBuffers(1, &verticesVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, verticesVBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Point), &vertices[0], GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 0, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glGenBuffers(1, &normalsVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, normalsVBO);
-	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(Point), &normals[0], GL_STATIC_DRAW);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_DOUBLE, GL_FALSE, 0, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glGenBuffers(1, &colorsVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, colorsVBO);
-	glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(Color), &colors[0], GL_STATIC_DRAW);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 4, GL_DOUBLE, GL_FALSE, 0, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glGenBuffers(1, &indicesVBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indicesVBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(Index), &indices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glBindVertexArray(0);
-}
-
-inline void Shape::deleteVAO()
-{
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
-	glDeleteVertexArrays(1, &shapeVAO);
-	glDeleteBuffers(1, &verticesVBO);
-	glDeleteBuffers(1, &normalsVBO);
-	glDeleteBuffers(1, &colorsVBO);
-	glDeleteBuffers(1, &indicesVBO);
+#pragma once
+#include "Utils.h"
+#include "Program.h"
+#include "Parametric.h"
+#include "MeshOptimizer.h"
+#include "StreamBuffer.h"
+#include "Instances.h"
+
+/*
+ * Generic 3D Shape
+ *
+ * With UPLOAD off (software rendering, with no OpenGL context) shapes keep their CPU arrays only and make no GL call
+ */
+class Shape
+{
+public:
+	static bool UPLOAD;
+
+	struct SubMesh {
+		GLuint firstVertex, vertexCount;
+		GLuint firstElement, elementCount;
+		GLuint firstTriangle, triangleCount;
+	};
+
+	Shape();
+	Shape(vector<Point> v, vector<Point> n, vector<Index> i);
+	Shape(vector<Point> v, vector<Color> c, vector<Index> i);
+	Shape(vector<Point> v, vector<Point> n, vector<Color> c, vector<Index> i);
+	Shape(vector<Point> v, vector<Point> n, vector<Color> c, vector<Index> i, vector<GLuint> s, bool optimized = true);
+	Shape(vector<Shape*> parts);
+	virtual ~Shape();
+	virtual void draw();
+	virtual void draw(function<void()> &uniformVariableRoutine);
+	virtual void drawSubMesh(int index);
+	virtual void drawSubMesh(int index, function<void()> &uniformVariableRoutine);
+	virtual void drawLevel(int level);
+	virtual void bind(Shader* shader = NULL);
+	virtual void drawBound(int subMesh = -1, GLsizei instances = 1);
+
+	virtual void updateVAO();
+	virtual void updateVertices(GLuint first, GLuint count);
+	virtual void updateColors(GLuint first, GLuint count);
+	virtual void setDynamic(bool dynamic);
+	virtual bool isDynamic();
+	virtual void releaseMirror();
+	virtual bool hasMirror();
+	virtual vector<Point>* getVertices();
+	virtual vector<Point>* getNormals();
+	virtual vector<Color>* getColors();
+	virtual vector<Index>* getIndices();
+	virtual vector<GLuint>* getStrips();
+	virtual vector<SubMesh>* getSubMeshes();
+	virtual GLenum getIndexType();
+	virtual MeshOptimizer::Report getOptimizationReport();
+	virtual unsigned long getVersion();
+	virtual double getRadius();
+	virtual int getLevels();
+	virtual void selectLevel(double screenSize, int* level);
+
+private:
+	GLuint shapeVAO;
+	GLuint verticesVBO, normalsVBO, colorsVBO, indicesVBO;
+	vector<Point> vertices;
+	vector<Point> normals;
+	vector<Color> colors;
+	vector<Index> indices;
+	vector<GLuint> strips;
+	vector<SubMesh> subMeshes;
+	GLenum indexType;
+	double radius;
+	MeshOptimizer::Report report;
+	GLenum primitive = GL_TRIANGLES;
+	bool mirror = true;
+	bool dynamic = false;
+	unsigned int enabledAttributes = 7;
+	unsigned long version = 0;
+	static unsigned long uploads;
+	StreamBuffer* verticesStream = NULL;
+	StreamBuffer* colorsStream = NULL;
+	unsigned long streamedFrame = 0;
+
+	void optimize();
+	void updateRadius();
+	void stream();
+	void drawRange(SubMesh subMesh, GLsizei instances);
+	void createVAO();
+	void deleteVAO();
+};
+
+bool Shape::UPLOAD = true;
+unsigned long Shape::uploads = 0;
+
+Shape::Shape()
+{
+	shapeVAO = verticesVBO = normalsVBO = colorsVBO = indicesVBO = 0;
+	indexType = GL_UNSIGNED_INT;
+	radius = 0.0;
+}
+
+/*
+ * The arrays are taken by value and moved in, so that callers passing temporaries (or std::move) copy nothing
+ */
+Shape::Shape(vector<Point> v, vector<Point> n, vector<Index> i)
+{
+	vertices = std::move(v);
+	normals = std::move(n);
+	indices = std::move(i);
+	colors.assign(vertices.size(), { 1.0, 1.0, 1.0, 0.0 });
+
+	optimize();
+	createVAO();
+}
+
+Shape::Shape(vector<Point> v, vector<Color> c, vector<Index> i)
+{
+	vertices = std::move(v);
+	colors = std::move(c);
+	indices = std::move(i);
+	normals.assign(vertices.size(), { 0.0, 0.0, 0.0 });
+
+	optimize();
+	createVAO();
+}
+
+inline Shape::Shape(vector<Point> v, vector<Point> n, vector<Color> c, vector<Index> i)
+{
+	vertices = std::move(v);
+	normals = std::move(n);
+	colors = std::move(c);
+	indices = std::move(i);
+
+	optimize();
+	createVAO();
+}
+
+/*
+ * Triangle strips separated by Parametric::RESTART_INDEX are drawn instead of the triangles when not empty; with
+ * optimized false the arrays are uploaded in the given order, skipping the MeshOptimizer pass
+ */
+inline Shape::Shape(vector<Point> v, vector<Point> n, vector<Color> c, vector<Index> i, vector<GLuint> s, bool optimized)
+{
+	vertices = std::move(v);
+	normals = std::move(n);
+	colors = std::move(c);
+	indices = std::move(i);
+	strips = std::move(s);
+
+	if (optimized)
+		optimize();
+	createVAO();
+}
+
+/*
+ * Packs already built shapes (all drawn as triangles or all as strips) into the same buffers, one sub-mesh each;
+ * their indices stay relative to the sub-mesh first vertex on the GPU, so small parts keep 16-bit indices
+ */
+inline Shape::Shape(vector<Shape*> parts) : Shape()
+{
+	for (Shape* part : parts)
+	{
+		if (!part->hasMirror())
+			throw "cannot pack a shape without its CPU mirror";
+		if (part->getStrips()->empty() != parts.front()->getStrips()->empty())
+			throw "cannot mix triangles and strips";
+
+		GLuint offset = vertices.size();
+		GLuint elements = strips.empty() ? 3 * indices.size() : strips.size();
+		GLuint partElements = part->getStrips()->empty() ? 3 * part->getIndices()->size() : part->getStrips()->size();
+		subMeshes.push_back({ offset, (GLuint)part->getVertices()->size(), elements, partElements, (GLuint)indices.size(), (GLuint)part->getIndices()->size() });
+
+		vertices.insert(vertices.end(), part->getVertices()->begin(), part->getVertices()->end());
+		normals.insert(normals.end(), part->getNormals()->begin(), part->getNormals()->end());
+		colors.insert(colors.end(), part->getColors()->begin(), part->getColors()->end());
+		for (Index t : *part->getIndices())
+			indices.push_back({ t.i + offset, t.j + offset, t.k + offset });
+		for (GLuint v : *part->getStrips())
+			strips.push_back(v == Parametric::RESTART_INDEX ? v : v + offset);
+	}
+	if (!parts.empty())
+		report = parts.front()->getOptimizationReport();
+
+	createVAO();
+}
+
+Shape::~Shape()
+{
+	deleteVAO();
+}
+
+inline void Shape::draw()
+{
+	function<void()> routine = Shaders::DEFAULT_UNIFORM_VARIABLES_ROUTINE;
+	draw(routine);
+}
+
+inline void Shape::draw(function<void()>& uniformVariableRoutine)
+{
+	uniformVariableRoutine();
+	bind();
+	drawBound();
+	glBindVertexArray(0);
+}
+
+inline void Shape::drawSubMesh(int index)
+{
+	function<void()> routine = Shaders::DEFAULT_UNIFORM_VARIABLES_ROUTINE;
+	drawSubMesh(index, routine);
+}
+
+inline void Shape::drawSubMesh(int index, function<void()>& uniformVariableRoutine)
+{
+	uniformVariableRoutine();
+	bind();
+	drawBound(index);
+	glBindVertexArray(0);
+}
+
+/*
+ * Levels of detail are the sub-meshes, the finest first
+ */
+inline void Shape::drawLevel(int level)
+{
+	drawSubMesh(level);
+}
+
+/*
+ * Binds the VAO (streaming dynamic attributes first), so that several drawBound calls can follow with no rebinding,
+ * with the normals and colors arrays enabled only if the shader (the current one by default) reads them, and the
+ * instance attributes pointed at the last Instances pushed if it reads those
+ */
+inline void Shape::bind(Shader* shader)
+{
+	glBindVertexArray(shapeVAO);
+	stream();
+
+	if (shader == NULL)
+		shader = Program::getShader();
+	if (shader->usesAttribute(Instances::ATTRIBUTE))
+		Instances::bindAttributes();
+	for (GLuint location = 1; location <= 2; location++)
+	{
+		bool used = shader->usesAttribute(location);
+		if (used == ((enabledAttributes >> location & 1) != 0))
+			continue;
+		enabledAttributes ^= 1u << location;
+		if (used)
+			glEnableVertexAttribArray(location);
+		else
+			glDisableVertexAttribArray(location);
+	}
+}
+
+/*
+ * Draws one sub-mesh, or all of them when subMesh is negative, of the shape already bound, with no uniform update;
+ * instances above one are only told apart by instanced shaders
+ */
+inline void Shape::drawBound(int subMesh, GLsizei instances)
+{
+	if (subMesh >= 0)
+	{
+		drawRange(subMeshes.at(subMesh), instances);
+		return;
+	}
+	for (SubMesh range : subMeshes)
+		drawRange(range, instances);
+}
+
+inline void Shape::updateVAO()
+{
+	if (!mirror)
+		throw "cannot upload a shape without its CPU mirror";
+	deleteVAO();
+	createVAO();
+}
+
+/*
+ * To be called after editing count vertices from first through getVertices(): a dynamic shape streams the range into
+ * the regions of the following frames, a static one rewrites it in place; neither recreates the buffers, but both
+ * change the version and measure the radius again
+ */
+inline void Shape::updateVertices(GLuint first, GLuint count)
+{
+	if (!mirror)
+		throw "cannot upload a shape without its CPU mirror";
+	count = std::min<GLuint>(count, first < vertices.size() ? vertices.size() - first : 0);
+	if (count == 0)
+		return;
+
+	version = ++uploads;
+	updateRadius();
+	if (!UPLOAD)
+		return;
+	if (dynamic)
+	{
+		verticesStream->invalidate(first * sizeof(Point), count * sizeof(Point));
+		return;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, verticesVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Point), count * sizeof(Point), &vertices[first]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+inline void Shape::updateColors(GLuint first, GLuint count)
+{
+	if (!mirror)
+		throw "cannot upload a shape without its CPU mirror";
+	count = std::min<GLuint>(count, first < colors.size() ? colors.size() - first : 0);
+	if (count == 0)
+		return;
+
+	version = ++uploads;
+	if (!UPLOAD)
+		return;
+	if (dynamic)
+	{
+		colorsStream->invalidate(first * sizeof(Color), count * sizeof(Color));
+		return;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, colorsVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Color), count * sizeof(Color), &colors[first]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+ * Dynamic shapes keep vertices and colors in StreamBuffers, for geometry edited every frame
+ */
+inline void Shape::setDynamic(bool dynamic)
+{
+	if (this->dynamic == dynamic)
+		return;
+	if (!mirror)
+		throw "cannot upload a shape without its CPU mirror";
+
+	this->dynamic = dynamic;
+	updateVAO();
+}
+
+inline bool Shape::isDynamic()
+{
+	return dynamic;
+}
+
+/*
+ * Frees the CPU arrays of an uploaded shape: it can still be drawn, but no longer edited, streamed or packed
+ */
+inline void Shape::releaseMirror()
+{
+	if (dynamic)
+		throw "a dynamic shape needs its CPU mirror";
+
+	vector<Point>().swap(vertices);
+	vector<Point>().swap(normals);
+	vector<Color>().swap(colors);
+	vector<Index>().swap(indices);
+	vector<GLuint>().swap(strips);
+	mirror = false;
+}
+
+inline bool Shape::hasMirror()
+{
+	return mirror;
+}
+
+inline vector<Point>* Shape::getVertices()
+{
+	return &vertices;
+}
+
+inline vector<Point>* Shape::getNormals()
+{
+	return &normals;
+}
+
+inline vector<Color>* Shape::getColors()
+{
+	return &colors;
+}
+
+inline vector<Index>* Shape::getIndices()
+{
+	return &indices;
+}
+
+inline vector<GLuint>* Shape::getStrips()
+{
+	return &strips;
+}
+
+inline vector<Shape::SubMesh>* Shape::getSubMeshes()
+{
+	return &subMeshes;
+}
+
+/*
+ * GL_UNSIGNED_SHORT when every sub-mesh has fewer vertices than the 16-bit restart index, GL_UNSIGNED_INT otherwise
+ */
+inline GLenum Shape::getIndexType()
+{
+	return indexType;
+}
+
+/*
+ * Changes on every upload (the ranges given to updateVertices and updateColors included) and is never shared by two
+ * shapes, so that caches keyed by shape can tell stale entries
+ */
+inline unsigned long Shape::getVersion()
+{
+	return version;
+}
+
+/*
+ * ACMR of the triangles before and after the optimization pass run on construction
+ */
+inline MeshOptimizer::Report Shape::getOptimizationReport()
+{
+	return report;
+}
+
+/*
+ * Radius of the bounding sphere centered in the shape origin
+ */
+inline double Shape::getRadius()
+{
+	return radius;
+}
+
+inline int Shape::getLevels()
+{
+	return 1;
+}
+
+/*
+ * A shape with a single level keeps it whatever its screen size
+ */
+inline void Shape::selectLevel(double, int* level)
+{
+	*level = 0;
+}
+
+inline void Shape::optimize()
+{
+	vector<GLuint> remap;
+	report = MeshOptimizer::optimize(&vertices, &indices, &remap);
+	MeshOptimizer::remapAttribute(&normals, remap);
+	MeshOptimizer::remapAttribute(&colors, remap);
+
+	vector<GLuint> newIndex(remap.size());
+	for (GLuint v = 0; v < remap.size(); v++)
+		newIndex[remap[v]] = v;
+	for (GLuint& v : strips)
+		if (v != Parametric::RESTART_INDEX)
+			v = newIndex[v];
+}
+
+/*
+ * Brings the current frame region of the streamed attributes up to date and points the VAO (already bound) to it,
+ * once per frame however many bodies share the shape
+ */
+inline void Shape::stream()
+{
+	if (!dynamic || streamedFrame == StreamBuffer::getFrame())
+		return;
+
+	streamedFrame = StreamBuffer::getFrame();
+	verticesStream->update(vertices.data());
+	colorsStream->update(colors.data());
+	glBindBuffer(GL_ARRAY_BUFFER, verticesStream->getBuffer());
+	glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 0, (const void*)verticesStream->getOffset());
+	glBindBuffer(GL_ARRAY_BUFFER, colorsStream->getBuffer());
+	glVertexAttribPointer(2, 4, GL_DOUBLE, GL_FALSE, 0, (const void*)colorsStream->getOffset());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+inline void Shape::drawRange(SubMesh subMesh, GLsizei instances)
+{
+	size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	const void* offset = (const void*)(subMesh.firstElement * indexSize);
+	if (primitive == GL_TRIANGLES)
+	{
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, subMesh.elementCount, indexType, offset, instances, subMesh.firstVertex);
+		return;
+	}
+
+	glEnable(GL_PRIMITIVE_RESTART);
+	glPrimitiveRestartIndex(indexType == GL_UNSIGNED_SHORT ? 0xFFFF : Parametric::RESTART_INDEX);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLE_STRIP, subMesh.elementCount, indexType, offset, instances, subMesh.firstVertex);
+	glDisable(GL_PRIMITIVE_RESTART);
+}
+
+inline void Shape::updateRadius()
+{
+	radius = 0.0;
+	for (Point v : vertices)
+		radius = std::max(radius, sqrt(v.x * v.x + v.y * v.y + v.z * v.z));
+}
+
+inline void Shape::createVAO()
+{
+	version = ++uploads;
+	updateRadius();
+
+	// a single sub-mesh always spans the whole shape, which may have been edited since
+	primitive = strips.empty() ? GL_TRIANGLES : GL_TRIANGLE_STRIP;
+	GLuint elementCount = strips.empty() ? 3 * indices.size() : strips.size();
+	if (subMeshes.size() <= 1)
+		subMeshes.assign(1, { 0, (GLuint)vertices.size(), 0, elementCount, 0, (GLuint)indices.size() });
+	GLuint largest = 0;
+	for (SubMesh subMesh : subMeshes)
+		largest = std::max(largest, subMesh.vertexCount);
+	indexType = largest < 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	if (!UPLOAD)
+		return;
+
+	glGenVertexArrays(1, &shapeVAO);
+	glBindVertexArray(shapeVAO);
+	enabledAttributes = 7;
+
+	if (dynamic)
+	{
+		verticesStream = new StreamBuffer(vertices.size() * sizeof(Point));
+		verticesStream->invalidate(0, vertices.size() * sizeof(Point));
+		glEnableVertexAttribArray(0);
+	}
+	else
+	{
+		glGenBuffers(1, &verticesVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, verticesVBO);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Point), vertices.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 0, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	glGenBuffers(1, &normalsVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, normalsVBO);
+	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(Point), normals.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_DOUBLE, GL_FALSE, 0, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (dynamic)
+	{
+		colorsStream = new StreamBuffer(colors.size() * sizeof(Color));
+		colorsStream->invalidate(0, colors.size() * sizeof(Color));
+		glEnableVertexAttribArray(2);
+		streamedFrame = StreamBuffer::getFrame() - 1;
+	}
+	else
+	{
+		glGenBuffers(1, &colorsVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, colorsVBO);
+		glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(Color), colors.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_DOUBLE, GL_FALSE, 0, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	const GLuint* elements = strips.empty() ? (indices.empty() ? NULL : &indices[0].i) : &strips[0];
+	vector<GLushort> shortElements;
+	vector<GLuint> intElements;
+	for (SubMesh subMesh : subMeshes)
+	{
+		for (GLuint e = subMesh.firstElement; e < subMesh.firstElement + subMesh.elementCount; e++)
+		{
+			bool restart = elements[e] == Parametric::RESTART_INDEX;
+			if (indexType == GL_UNSIGNED_SHORT)
+				shortElements.push_back(restart ? 0xFFFF : GLushort(elements[e] - subMesh.firstVertex));
+			else
+				intElements.push_back(restart ? elements[e] : elements[e] - subMesh.firstVertex);
+		}
+	}
+
+	glGenBuffers(1, &indicesVBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indicesVBO);
+	if (indexType == GL_UNSIGNED_SHORT)
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortElements.size() * sizeof(GLushort), shortElements.data(), GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, intElements.size() * sizeof(GLuint), intElements.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindVertexArray(0);
+}
+
+inline void Shape::deleteVAO()
+{
+	if (!UPLOAD)
+		return;
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+	glDeleteVertexArrays(1, &shapeVAO);
+	glDeleteBuffers(1, &verticesVBO);
+	glDeleteBuffers(1, &normalsVBO);
+	glDeleteBuffers(1, &colorsVBO);
+	glDeleteBuffers(1, &indicesVBO);
+	verticesVBO = colorsVBO = 0;
+	delete verticesStream;
+	delete colorsStream;
+	verticesStream = colorsStream = NULL;
 }
\ No newline at end of file
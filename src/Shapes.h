@@ -1,268 +1,272 @@
-#pragma once
-#include "Utils.h"
-#include "Shape.h"
-
-enum DefaultShapes { PLANE = 0, CUBE = 1, PYRAMID = 2, SPHERE = 3, CILINDER = 4, CONE = 5, TORUS = 6 };
-
-/*
- * Utility Class with Main Shapes
- */
-class Shapes
-{
-public:
-	// NORMALIZED SHAPES
-	static Shape* PLANE;
-	static Shape* CUBE;
-	static Shape* PYRAMID;
-	static Shape* SPHERE;
-	static Shape* CILINDER;
-	static Shape* CONE;
-	static Shape* TORUS;
-
-	// SHAPES FACTORY
-	static void initDefault();
-	static Shape* plane(Dimension dimensions = { 1.0, 1.0, 1.0 }, Optional<Color> c = Optional<Color>());
-	static Shape* cube(Dimension dimensions = { 1.0, 1.0, 1.0 }, Optional<Color> c = Optional<Color>());
-	static Shape* pyramid(Dimension dimensions = { 1.0, 1.0, 1.0 }, Optional<Color> c = Optional<Color>());
-	static Shape* sphere(Dimension dimensions = { 1.0, 1.0, 1.0 }, Optional<Color> c = Optional<Color>());
-	static Shape* cilinder(Dimension dimensions = { 1.0, 1.0, 1.0 }, Optional<Color> c = Optional<Color>());
-	static Shape* cone(Dimension dimensions = { 1.0, 1.0, 1.0 }, Optional<Color> c = Optional<Color>());
-	static Shape* torus(Dimension dimensions = { 0.75, 0.75, 0.75 }, Dimension thickness = { 0.25, 0.25, 0.25 }, Optional<Color> c = Optional<Color>());
-
-private:
-	static vector<Point> getNormalsVector(vector<Point> v);
-	static vector<Color> getColorsVector(Optional<Color> c, unsigned int size);
-
-	Shapes();
-};
-
-Shape* Shapes::PLANE;
-Shape* Shapes::CUBE;
-Shape* Shapes::PYRAMID;
-Shape* Shapes::SPHERE;
-Shape* Shapes::CILINDER;
-Shape* Shapes::CONE;
-Shape* Shapes::TORUS;
-
-inline void Shapes::initDefault()
-{
-	PLANE = Shapes::plane();
-	CUBE = Shapes::cube();
-	PYRAMID = Shapes::pyramid();
-	SPHERE = Shapes::sphere();
-	CILINDER = Shapes::cilinder();
-	CONE = Shapes::cone();
-	TORUS = Shapes::torus();
-}
-
-inline Shape* Shapes::plane(Dimension dimensions, Optional<Color> c)
-{
-	double x = dimensions.width / 2.0;
-	double y = dimensions.height / 2.0;
-	double z = dimensions.depth / 2.0;
-
-	vector<Point> vertices;
-	vertices.push_back({ -x, 0.0,  z });
-	vertices.push_back({  x, 0.0,  z });
-	vertices.push_back({  x, 0.0, -z });
-	vertices.push_back({ -x, 0.0, -z });
-
-	vector<Index> indices;
-	indices.push_back({ 0, 1, 2 });
-	indices.push_back({ 0, 2, 3 });
-
-	vector<Point> normals;
-	normals.push_back({ 0.0, 1.0, 0.0 });
-	normals.push_back({ 0.0, 1.0, 0.0 });
-	normals.push_back({ 0.0, 1.0, 0.0 });
-	normals.push_back({ 0.0, 1.0, 0.0 });
-
-	return new Shape(vertices, normals, getColorsVector(c, vertices.size()), indices);
-}
-
-inline Shape* Shapes::cube(Dimension dimensions, Optional<Color> c)
-{
-	double x = dimensions.width / 2.0;
-	double y = dimensions.height / 2.0;
-	double z = dimensions.depth / 2.0;
-
-	vector<Point> vertices;
-	vertices.push_back({ -x, -y,  z });
-	vertices.push_back({  x, -y,  z });
-	vertices.push_back({  x,  y,  z });
-	vertices.push_back({ -x,  y,  z });
-	vertices.push_back({ -x, -y, -z });
-	vertices.push_back({  x, -y, -z });
-	vertices.push_back({  x,  y, -z });
-	vertices.push_back({ -x,  y, -z });
-
-	vector<Index> indices;
-	indices.push_back({ 0, 1, 2 });
-	indices.push_back({ 2, 3, 0 });
-	indices.push_back({ 1, 5, 6 });
-	indices.push_back({ 6, 2, 1 });
-	indices.push_back({ 7, 6, 5 });
-	indices.push_back({ 5, 4, 7 });
-	indices.push_back({ 4, 0, 3 });
-	indices.push_back({ 3, 7, 4 });
-	indices.push_back({ 4, 5, 1 });
-	indices.push_back({ 1, 0, 4 });
-	indices.push_back({ 3, 2, 6 });
-	indices.push_back({ 6, 7, 3 });
-
-	return new Shape(vertices, getNormalsVector(vertices), getColorsVector(c, vertices.size()), indices);
-}
-
-inline Shape* Shapes::pyramid(Dimension dimensions, Optional<Color> c)
-{
-	double x = dimensions.width / 2.0;
-	double y = dimensions.height / 2.0;
-	double z = dimensions.depth / 2.0;
-
-	vector<Point> vertices;
-	vertices.push_back({ -x, -y,  z });
-	vertices.push_back({  x, -y,  z });
-	vertices.push_back({  x, -y, -z });
-	vertices.push_back({ -x, -y, -z });
-	vertices.push_back({  0,  y,  0 });
-
-	vector<Index> indices;
-	indices.push_back({ 0, 1, 2 });
-	indices.push_back({ 0, 2, 3 });
-	indices.push_back({ 0, 4, 3 });
-	indices.push_back({ 0, 1, 4 });
-	indices.push_back({ 3, 2, 4 });
-	indices.push_back({ 1, 2, 4 });
-
-	vector<Point> normals;
-	normals.push_back({ 0.0, -1.0, 0.0 });
-	normals.push_back({ 0.0, -1.0, 0.0 });
-	normals.push_back({ 0.0, -1.0, 0.0 });
-	normals.push_back({ 0.0, -1.0, 0.0 });
-	normals.push_back({ 0.0,  1.0, 0.0 });
-
-	return new Shape(vertices, getNormalsVector(vertices), getColorsVector(c, vertices.size()), indices);
-}
-
-inline Shape* Shapes::sphere(Dimension dimensions, Optional<Color> c)
-{
-	double x = dimensions.width / 2.0;
-	double y = dimensions.height / 2.0;
-	double z = dimensions.depth / 2.0;
-
-	vector<Point> vertices;
-	unsigned int stacks = 30, slices = 30;
-	double phi, theta;
-	for (unsigned int i = 0; i <= stacks; i++) {
-		phi = i * glm::pi<double>() / stacks;
-		for (unsigned int j = 0; j <= slices; j++) {
-			theta = 2 * j * glm::pi<double>() / slices;
-			vertices.push_back({ x * cos(theta) * sin(phi), y * cos(phi), z * sin(theta) * sin(phi) });
-		}
-	}
-
-	vector<Index> indices;
-	for (unsigned int i = 0; i < slices * (stacks + 1); i++) {
-		indices.push_back({ i, i + slices + 1, i + slices });
-		indices.push_back({ i + slices + 1, i, i + 1 });;
-	}
-
-	return new Shape(vertices, getNormalsVector(vertices), getColorsVector(c, vertices.size()), indices);
-}
-
-inline Shape* Shapes::cilinder(Dimension dimensions, Optional<Color> c)
-{
-	double x = dimensions.width / 2.0;
-	double y = dimensions.height / 2.0;
-	double z = dimensions.depth / 2.0;
-
-	vector<Point> vertices;
-	unsigned int stacks = 30, slices = 30;
-	double h, theta;
-	for (unsigned int i = 0; i <= stacks; i++) {
-		h = i / double(stacks);
-		for (unsigned int j = 0; j <= slices; j++) {
-			theta = 2 * j * glm::pi<double>() / slices;
-			vertices.push_back({ x * cos(theta), y * (h - 0.5), z * sin(theta) });
-		}
-	}
-
-	vector<Index> indices;
-	for (unsigned int i = 0; i < slices * (stacks + 1); i++) {
-		indices.push_back({ i, i + slices + 1, i + slices });
-		indices.push_back({ i + slices + 1, i, i + 1 });
-	}
-
-	return new Shape(vertices, getNormalsVector(vertices), getColorsVector(c, vertices.size()), indices);
-}
-
-inline Shape* Shapes::cone(Dimension dimensions, Optional<Color> c)
-{
-	double x = dimensions.width / 2.0;
-	double y = dimensions.height / 2.0;
-	double z = dimensions.depth / 2.0;
-
-	vector<Point> vertices;
-	unsigned int stacks = 30, slices = 30;
-	double h, theta;
-	for (unsigned int i = 0; i <= stacks; i++) {
-		h = i / double(stacks);
-		for (unsigned int j = 0; j <= slices; j++) {
-			theta = 2 * j * glm::pi<double>() / slices;
-			vertices.push_back({ x * h * cos(theta), y * (h - 0.5), z * h * sin(theta) });
-		}
-	}
-
-	vector<Index> indices;
-	for (unsigned int i = 0; i < slices * (stacks + 1); i++) {
-		indices.push_back({ i, i + slices + 1, i + slices });
-		indices.push_back({ i + slices + 1, i, i + 1 });
-	}
-
-	return new Shape(vertices, getNormalsVector(vertices), getColorsVector(c, vertices.size()), indices);
-}
-
-inline Shape* Shapes::torus(Dimension dimensions, Dimension thickness, Optional<Color> c)
-{
-	double x = dimensions.width / 2.0;
-	double y = dimensions.height / 2.0;
-	double z = dimensions.depth / 2.0;
-	double tx = thickness.width / 2.0;
-	double ty = thickness.height / 2.0;
-	double tz = thickness.depth / 2.0;
-
-	vector<Point> vertices;
-	unsigned int stacks = 30, slices = 30;
-	double phi, theta;
-	for (unsigned int i = 0; i <= stacks; i++) {
-		phi = 2 * i * glm::pi<double>() / stacks;
-		for (unsigned int j = 0; j <= slices; j++) {
-			theta = 2 * j * glm::pi<double>() / slices;
-			vertices.push_back({ (x + tx * cos(phi)) * cos(theta),  (y + ty * sin(phi)), (z + tz * cos(phi))* sin(theta) });
-		}
-	}
-
-	vector<Index> indices;
-	for (unsigned int i = 0; i < slices * (stacks + 1); i++) {
-		indices.push_back({ i, i + slices + 1, i + slices });
-		indices.push_back({ i + slices + 1, i, i + 1 });
-	}
-
-	return new Shape(vertices, getNormalsVector(vertices), getColorsVector(c, vertices.size()), indices);
-}
-
-inline vector<Point> Shapes::getNormalsVector(vector<Point> v) {
-	vector<Point> normals;
-	for (unsigned int i = 0; i < v.size(); i++) {
-		normals.push_back(v.at(i));
-	}
-	return normals;
-}
-
-inline vector<Color> Shapes::getColorsVector(Optional<Color> c, unsigned int size) {
-	vector<Color> colors;
-	for (unsigned int i = 0; i < size; i++)
-		colors.push_back(c.orElse({ rand(0.0, 1.0), rand(0.0, 1.0), rand(0.0, 1.0), 1.0 }));
-	return colors;
-}
-
+#pragma once
+#include "Utils.h"
+#include "Shape.h"
+#include "LodShape.h"
+#include "Parametric.h"
+#include "Normals.h"
+#include "MeshBuilder.h"
+
+/*
+ * Parametric Surfaces of the Round Shapes (see Parametric), given their semi-axes
+ */
+struct SphereSurface {
+	static const bool WRAP_U = true, WRAP_V = false, POLE_START = true, POLE_END = true;
+	double x, y, z;
+	Point operator()(double u, double v) const {
+		double phi = v * glm::pi<double>(), theta = 2 * u * glm::pi<double>();
+		return { x * cos(theta) * sin(phi), y * cos(phi), z * sin(theta) * sin(phi) };
+	}
+	Point normal(double u, double v) const {
+		Point p = (*this)(u, v);
+		return { p.x / (x * x), p.y / (y * y), p.z / (z * z) };
+	}
+};
+
+struct CilinderSurface {
+	static const bool WRAP_U = true, WRAP_V = false, POLE_START = false, POLE_END = false;
+	double x, y, z;
+	Point operator()(double u, double v) const {
+		double theta = 2 * u * glm::pi<double>();
+		return { x * cos(theta), y * (v - 0.5), z * sin(theta) };
+	}
+	Point normal(double u, double) const {
+		double theta = 2 * u * glm::pi<double>();
+		return { cos(theta) / x, 0.0, sin(theta) / z };
+	}
+};
+
+struct ConeSurface {
+	static const bool WRAP_U = true, WRAP_V = false, POLE_START = true, POLE_END = false;
+	double x, y, z;
+	Point operator()(double u, double v) const {
+		double theta = 2 * u * glm::pi<double>();
+		return { x * v * cos(theta), y * (v - 0.5), z * v * sin(theta) };
+	}
+	Point normal(double u, double v) const {
+		double theta = 2 * u * glm::pi<double>();
+		return v == 0.0 ? Point(0.0, -1.0, 0.0) : Point(cos(theta) / x, -1.0 / y, sin(theta) / z);
+	}
+};
+
+struct TorusSurface {
+	static const bool WRAP_U = true, WRAP_V = true, POLE_START = false, POLE_END = false;
+	double x, y, z, tx, ty, tz;
+	Point operator()(double u, double v) const {
+		double phi = 2 * v * glm::pi<double>(), theta = 2 * u * glm::pi<double>();
+		return { (x + tx * cos(phi)) * cos(theta), y + ty * sin(phi), (z + tz * cos(phi)) * sin(theta) };
+	}
+	Point normal(double u, double v) const {
+		double phi = 2 * v * glm::pi<double>(), theta = 2 * u * glm::pi<double>();
+		dvec3 dPhi(-tx * sin(phi) * cos(theta), ty * cos(phi), -tz * sin(phi) * sin(theta));
+		dvec3 dTheta(-(x + tx * cos(phi)) * sin(theta), 0.0, (z + tz * cos(phi)) * cos(theta));
+		dvec3 n = cross(dPhi, dTheta);
+		return { n.x, n.y, n.z };
+	}
+};
+
+enum DefaultShapes { PLANE = 0, CUBE = 1, PYRAMID = 2, SPHERE = 3, CILINDER = 4, CONE = 5, TORUS = 6 };
+
+/*
+ * Utility Class with Main Shapes
+ */
+class Shapes
+{
+public:
+	// NORMALIZED SHAPES
+	static Shape* PLANE;
+	static Shape* CUBE;
+	static Shape* PYRAMID;
+	static Shape* SPHERE;
+	static Shape* CILINDER;
+	static Shape* CONE;
+	static Shape* TORUS;
+
+	// TESSELLATION
+	static const unsigned int DEFAULT_SEGMENTS;
+	static const vector<unsigned int> LOD_SEGMENTS;
+	static const vector<double> LOD_SCREEN_SIZES;
+	static bool STRIPS;
+
+	// SHAPES FACTORY
+	static void initDefault();
+	static Shape* lod(function<Shape*(unsigned int)> factory);
+	static Shape* lod(DefaultShapes shape);
+	static Shape* plane(Dimension dimensions = { 1.0, 1.0, 1.0 }, Optional<Color> c = Optional<Color>());
+	static Shape* cube(Dimension dimensions = { 1.0, 1.0, 1.0 }, Optional<Color> c = Optional<Color>());
+	static Shape* pyramid(Dimension dimensions = { 1.0, 1.0, 1.0 }, Optional<Color> c = Optional<Color>());
+	static Shape* sphere(Dimension dimensions = { 1.0, 1.0, 1.0 }, unsigned int segments = DEFAULT_SEGMENTS, Optional<Color> c = Optional<Color>());
+	static Shape* cilinder(Dimension dimensions = { 1.0, 1.0, 1.0 }, unsigned int segments = DEFAULT_SEGMENTS, Optional<Color> c = Optional<Color>());
+	static Shape* cone(Dimension dimensions = { 1.0, 1.0, 1.0 }, unsigned int segments = DEFAULT_SEGMENTS, Optional<Color> c = Optional<Color>());
+	static Shape* torus(Dimension dimensions = { 0.75, 0.75, 0.75 }, Dimension thickness = { 0.25, 0.25, 0.25 }, unsigned int segments = DEFAULT_SEGMENTS, Optional<Color> c = Optional<Color>());
+
+private:
+	template <class S> static Shape* parametric(const S& surface, unsigned int stacks, unsigned int slices, Optional<Color> c);
+
+	Shapes();
+};
+
+Shape* Shapes::PLANE;
+Shape* Shapes::CUBE;
+Shape* Shapes::PYRAMID;
+Shape* Shapes::SPHERE;
+Shape* Shapes::CILINDER;
+Shape* Shapes::CONE;
+Shape* Shapes::TORUS;
+
+const unsigned int Shapes::DEFAULT_SEGMENTS = 30;
+const vector<unsigned int> Shapes::LOD_SEGMENTS = { 64, 32, 16, 8 };
+const vector<double> Shapes::LOD_SCREEN_SIZES = { 0.5, 0.2, 0.05, 0.0 };
+bool Shapes::STRIPS = false;
+
+inline void Shapes::initDefault()
+{
+	PLANE = Shapes::plane();
+	CUBE = Shapes::cube();
+	PYRAMID = Shapes::pyramid();
+	SPHERE = Shapes::lod(DefaultShapes::SPHERE);
+	CILINDER = Shapes::lod(DefaultShapes::CILINDER);
+	CONE = Shapes::lod(DefaultShapes::CONE);
+	TORUS = Shapes::lod(DefaultShapes::TORUS);
+}
+
+/*
+ * Builds one level per LOD_SEGMENTS entry, used down to the matching LOD_SCREEN_SIZES
+ */
+inline Shape* Shapes::lod(function<Shape*(unsigned int)> factory)
+{
+	vector<Shape*> levels;
+	for (unsigned int segments : LOD_SEGMENTS)
+		levels.push_back(factory(segments));
+	return new LodShape(levels, LOD_SCREEN_SIZES);
+}
+
+/*
+ * Levels of detail of a round default shape, with random colors of its own
+ */
+inline Shape* Shapes::lod(DefaultShapes shape)
+{
+	switch (shape)
+	{
+	case DefaultShapes::SPHERE:
+		return lod([](unsigned int segments) { return sphere({ 1.0, 1.0, 1.0 }, segments); });
+	case DefaultShapes::CILINDER:
+		return lod([](unsigned int segments) { return cilinder({ 1.0, 1.0, 1.0 }, segments); });
+	case DefaultShapes::CONE:
+		return lod([](unsigned int segments) { return cone({ 1.0, 1.0, 1.0 }, segments); });
+	case DefaultShapes::TORUS:
+		return lod([](unsigned int segments) { return torus({ 0.75, 0.75, 0.75 }, { 0.25, 0.25, 0.25 }, segments); });
+	default:
+		throw "no levels of detail for this shape";
+	}
+}
+
+inline Shape* Shapes::plane(Dimension dimensions, Optional<Color> c)
+{
+	double x = dimensions.width / 2.0;
+	double y = dimensions.height / 2.0;
+	double z = dimensions.depth / 2.0;
+
+	MeshBuilder mesh;
+	vector<Point>* vertices = mesh.reserve(4, 2)->getVertices();
+	vertices->push_back({ -x, 0.0,  z });
+	vertices->push_back({  x, 0.0,  z });
+	vertices->push_back({  x, 0.0, -z });
+	vertices->push_back({ -x, 0.0, -z });
+
+	mesh.addTriangle(0, 1, 2)
+		->addTriangle(0, 2, 3);
+
+	mesh.getNormals()->assign(vertices->size(), { 0.0, 1.0, 0.0 });
+	return mesh.fillColors(c)->build();
+}
+
+inline Shape* Shapes::cube(Dimension dimensions, Optional<Color> c)
+{
+	double x = dimensions.width / 2.0;
+	double y = dimensions.height / 2.0;
+	double z = dimensions.depth / 2.0;
+
+	MeshBuilder mesh;
+	vector<Point>* vertices = mesh.reserve(24, 12)->getVertices();
+	vertices->push_back({ -x, -y,  z });
+	vertices->push_back({  x, -y,  z });
+	vertices->push_back({  x,  y,  z });
+	vertices->push_back({ -x,  y,  z });
+	vertices->push_back({ -x, -y, -z });
+	vertices->push_back({  x, -y, -z });
+	vertices->push_back({  x,  y, -z });
+	vertices->push_back({ -x,  y, -z });
+
+	mesh.addTriangle(0, 1, 2)
+		->addTriangle(2, 3, 0)
+		->addTriangle(1, 5, 6)
+		->addTriangle(6, 2, 1)
+		->addTriangle(7, 6, 5)
+		->addTriangle(5, 4, 7)
+		->addTriangle(4, 0, 3)
+		->addTriangle(3, 7, 4)
+		->addTriangle(4, 5, 1)
+		->addTriangle(1, 0, 4)
+		->addTriangle(3, 2, 6)
+		->addTriangle(6, 7, 3);
+
+	*mesh.getNormals() = Normals::flat(vertices, mesh.getIndices());
+	return mesh.fillColors(c)->build();
+}
+
+inline Shape* Shapes::pyramid(Dimension dimensions, Optional<Color> c)
+{
+	double x = dimensions.width / 2.0;
+	double y = dimensions.height / 2.0;
+	double z = dimensions.depth / 2.0;
+
+	MeshBuilder mesh;
+	vector<Point>* vertices = mesh.reserve(16, 6)->getVertices();
+	vertices->push_back({ -x, -y,  z });
+	vertices->push_back({  x, -y,  z });
+	vertices->push_back({  x, -y, -z });
+	vertices->push_back({ -x, -y, -z });
+	vertices->push_back({  0,  y,  0 });
+
+	mesh.addTriangle(0, 2, 1)
+		->addTriangle(0, 3, 2)
+		->addTriangle(0, 4, 3)
+		->addTriangle(0, 1, 4)
+		->addTriangle(3, 4, 2)
+		->addTriangle(1, 2, 4);
+
+	*mesh.getNormals() = Normals::flat(vertices, mesh.getIndices());
+	return mesh.fillColors(c)->build();
+}
+
+inline Shape* Shapes::sphere(Dimension dimensions, unsigned int segments, Optional<Color> c)
+{
+	return parametric(SphereSurface{ dimensions.width / 2.0, dimensions.height / 2.0, dimensions.depth / 2.0 }, segments, segments, c);
+}
+
+inline Shape* Shapes::cilinder(Dimension dimensions, unsigned int segments, Optional<Color> c)
+{
+	return parametric(CilinderSurface{ dimensions.width / 2.0, dimensions.height / 2.0, dimensions.depth / 2.0 }, segments, segments, c);
+}
+
+inline Shape* Shapes::cone(Dimension dimensions, unsigned int segments, Optional<Color> c)
+{
+	return parametric(ConeSurface{ dimensions.width / 2.0, dimensions.height / 2.0, dimensions.depth / 2.0 }, segments, segments, c);
+}
+
+inline Shape* Shapes::torus(Dimension dimensions, Dimension thickness, unsigned int segments, Optional<Color> c)
+{
+	TorusSurface surface = {
+		dimensions.width / 2.0, dimensions.height / 2.0, dimensions.depth / 2.0,
+		thickness.width / 2.0, thickness.height / 2.0, thickness.depth / 2.0
+	};
+	return parametric(surface, segments, segments, c);
+}
+
+template <class S>
+inline Shape* Shapes::parametric(const S& surface, unsigned int stacks, unsigned int slices, Optional<Color> c)
+{
+	MeshBuilder mesh;
+	Parametric::generate(surface, stacks, slices, mesh.getVertices(), mesh.getNormals(), mesh.getIndices(), STRIPS ? mesh.getStrips() : NULL);
+	return mesh.fillColors(c)->build();
+}
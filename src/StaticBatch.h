@@ -0,0 +1,230 @@
+#pragma once
+#include "Utils.h"
+#include "RigidBody.h"
+#include "MeshBuilder.h"
+#include "Frustum.h"
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+/*
+ * Merged Geometry of the Static Bodies, Split into Cubic Chunks of CHUNK_SIZE
+ *
+ * The finest level of each member is transformed once and appended to the chunk containing the body position;
+ * every chunk is one Shape, culled against the view frustum by collect and drawn with a single call.
+ * update compares the members with the bodies every frame and only rebuilds the chunks whose members were added,
+ * removed or changed (moved, or with a shape edited since); the excluded body (the one being edited) is left out of
+ * the batch and drawn on its own
+ */
+class StaticBatch
+{
+public:
+	static const double CHUNK_SIZE;
+
+	StaticBatch();
+	~StaticBatch();
+
+	StaticBatch* update(const vector<RigidBody*>& bodies, RigidBody* excluded = NULL);
+	void collect(Frustum* frustum, vector<Shape*>* visible);
+	bool contains(RigidBody* body);
+	int getChunks();
+	int getRebuilds();
+
+private:
+	typedef tuple<int, int, int> Key;
+
+	struct Chunk {
+		vector<RigidBody*> members;
+		Shape* shape = NULL;
+		Point center;
+		double radius = 0.0;
+		bool dirty = false;
+	};
+
+	struct Member {
+		Key key;
+		Shape* shape;
+		unsigned long version;
+		mat4 transform;
+		unsigned long frame;
+	};
+
+	map<Key, Chunk> chunks;
+	unordered_map<RigidBody*, Member> members;
+	unsigned long frame;
+	int rebuilds;
+
+	Key getKey(Point position);
+	void insert(RigidBody* body);
+	void erase(RigidBody* body);
+	void rebuild(Chunk* chunk);
+	static void append(MeshBuilder* mesh, RigidBody* body);
+};
+
+const double StaticBatch::CHUNK_SIZE = 16.0;
+
+inline StaticBatch::StaticBatch()
+{
+	frame = 0;
+	rebuilds = 0;
+}
+
+inline StaticBatch::~StaticBatch()
+{
+	for (pair<const Key, Chunk>& chunk : chunks)
+		delete chunk.second.shape;
+}
+
+inline StaticBatch* StaticBatch::update(const vector<RigidBody*>& bodies, RigidBody* excluded)
+{
+	frame++;
+	for (RigidBody* body : bodies)
+	{
+		if (!body->isStatic() || body == excluded || body->getShape() == NULL)
+			continue;
+
+		unordered_map<RigidBody*, Member>::iterator member = members.find(body);
+		if (member != members.end() && (member->second.shape != body->getShape() || member->second.version != body->getShape()->getVersion()
+			|| member->second.transform != body->getTransform()))
+		{
+			erase(body);
+			member = members.end();
+		}
+		if (member == members.end())
+			insert(body);
+		members[body].frame = frame;
+	}
+
+	// members not met above were deleted, made dynamic or excluded
+	vector<RigidBody*> removed;
+	for (pair<RigidBody* const, Member>& member : members)
+		if (member.second.frame != frame)
+			removed.push_back(member.first);
+	for (RigidBody* body : removed)
+		erase(body);
+
+	for (map<Key, Chunk>::iterator chunk = chunks.begin(); chunk != chunks.end();)
+	{
+		if (chunk->second.dirty)
+			rebuild(&chunk->second);
+		if (chunk->second.members.empty())
+			chunk = chunks.erase(chunk);
+		else
+			chunk++;
+	}
+	return this;
+}
+
+/*
+ * Appends the shapes of the chunks in the frustum, already in world coordinates
+ */
+inline void StaticBatch::collect(Frustum* frustum, vector<Shape*>* visible)
+{
+	for (pair<const Key, Chunk>& chunk : chunks)
+	{
+		if (chunk.second.shape != NULL && frustum->intersects(chunk.second.center, chunk.second.radius))
+			visible->push_back(chunk.second.shape);
+	}
+}
+
+inline bool StaticBatch::contains(RigidBody* body)
+{
+	return members.find(body) != members.end();
+}
+
+/*
+ * Number of chunks currently holding members
+ */
+inline int StaticBatch::getChunks()
+{
+	return chunks.size();
+}
+
+/*
+ * Number of chunks rebuilt so far
+ */
+inline int StaticBatch::getRebuilds()
+{
+	return rebuilds;
+}
+
+inline StaticBatch::Key StaticBatch::getKey(Point position)
+{
+	return Key(int(floor(position.x / CHUNK_SIZE)), int(floor(position.y / CHUNK_SIZE)), int(floor(position.z / CHUNK_SIZE)));
+}
+
+inline void StaticBatch::insert(RigidBody* body)
+{
+	Key key = getKey(body->getPosition());
+	Chunk& chunk = chunks[key];
+	chunk.members.push_back(body);
+	chunk.dirty = true;
+	members[body] = { key, body->getShape(), body->getShape()->getVersion(), body->getTransform(), frame };
+}
+
+inline void StaticBatch::erase(RigidBody* body)
+{
+	Chunk& chunk = chunks[members[body].key];
+	chunk.members.erase(find(chunk.members.begin(), chunk.members.end(), body));
+	chunk.dirty = true;
+	members.erase(body);
+}
+
+inline void StaticBatch::rebuild(Chunk* chunk)
+{
+	delete chunk->shape;
+	chunk->shape = NULL;
+	chunk->dirty = false;
+	if (chunk->members.empty())
+		return;
+
+	// the members are already optimized, and the merged chunk is rebuilt too often to pay for the pass again
+	MeshBuilder mesh;
+	mesh.setOptimize(false);
+	for (RigidBody* body : chunk->members)
+		append(&mesh, body);
+
+	vector<Point>* vertices = mesh.getVertices();
+	if (vertices->empty())
+		return;
+
+	dvec3 low(vertices->front().x, vertices->front().y, vertices->front().z), high = low;
+	for (Point v : *vertices)
+	{
+		low = dvec3(std::min(low.x, v.x), std::min(low.y, v.y), std::min(low.z, v.z));
+		high = dvec3(std::max(high.x, v.x), std::max(high.y, v.y), std::max(high.z, v.z));
+	}
+	dvec3 center = (low + high) * 0.5;
+	chunk->center = { center.x, center.y, center.z };
+	chunk->radius = length(high - center);
+	chunk->shape = mesh.build();
+	rebuilds++;
+}
+
+/*
+ * Only the first sub-mesh (the finest level of a LodShape) is merged
+ */
+inline void StaticBatch::append(MeshBuilder* mesh, RigidBody* body)
+{
+	Shape* shape = body->getShape();
+	if (!shape->hasMirror())
+		throw "cannot batch a shape without its CPU mirror";
+
+	Shape::SubMesh finest = shape->getSubMeshes()->front();
+	mat4 model = body->getTransform();
+	mat3 normalMatrix = transpose(inverse(mat3(model)));
+	GLuint offset = mesh->getVertices()->size();
+	for (GLuint v = finest.firstVertex; v < finest.firstVertex + finest.vertexCount; v++)
+	{
+		Point p = shape->getVertices()->at(v), n = shape->getNormals()->at(v);
+		vec4 position = model * vec4(vec3(p.x, p.y, p.z), 1.0f);
+		vec3 normal = normalMatrix * vec3(n.x, n.y, n.z);
+		mesh->addVertex({ position.x, position.y, position.z }, Normals::normalize({ normal.x, normal.y, normal.z }), shape->getColors()->at(v));
+	}
+
+	for (GLuint i = finest.firstTriangle; i < finest.firstTriangle + finest.triangleCount; i++)
+	{
+		Index t = shape->getIndices()->at(i);
+		mesh->addTriangle(t.i - finest.firstVertex + offset, t.j - finest.firstVertex + offset, t.k - finest.firstVertex + offset);
+	}
+}
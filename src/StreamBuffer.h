@@ -0,0 +1,209 @@
+#pragma once
+#include "Utils.h"
+#include <cstring>
+
+/*
+ * Persistently Mapped Buffer Split into one Region per Frame in Flight
+ *
+ * The CPU only writes the region of the current frame while the GPU still reads the others; the fence placed by
+ * endFrame guards that region, so beginFrame only waits when the GPU is more than REGIONS - 1 frames behind.
+ * A buffer is either a mirror of CPU data (invalidate the modified bytes, then update copies them into each region
+ * the first time that region is written again) or a per-frame arena (allocate appends to the current region).
+ * Without ARB_buffer_storage the same writes go through glBufferSubData
+ */
+class StreamBuffer
+{
+public:
+	static const int REGIONS = 3;
+
+	StreamBuffer(GLsizeiptr regionSize);
+	~StreamBuffer();
+
+	GLuint getBuffer();
+	GLsizeiptr getRegionSize();
+	GLintptr getOffset();
+	void invalidate(GLintptr first, GLsizeiptr size);
+	void update(const void* source);
+	GLintptr allocate(const void* data, GLsizeiptr size, GLsizeiptr alignment = 1);
+
+	static GLintptr append(StreamBuffer** buffer, const void* data, GLsizeiptr size, GLsizeiptr alignment = 1);
+	static unsigned long getFrame();
+	static void beginFrame();
+	static void endFrame();
+
+private:
+	struct Range {
+		GLintptr first, last;
+	};
+
+	GLuint buffer;
+	GLsizeiptr regionSize;
+	GLubyte* mapping;
+	Range dirty[REGIONS];
+	GLsizeiptr used;
+	unsigned long usedFrame;
+
+	void write(GLintptr offset, const void* data, GLsizeiptr size);
+
+	static unsigned long frame;
+	static GLsync fences[REGIONS];
+};
+
+unsigned long StreamBuffer::frame = 0;
+GLsync StreamBuffer::fences[StreamBuffer::REGIONS] = {};
+
+inline StreamBuffer::StreamBuffer(GLsizeiptr regionSize)
+{
+	this->regionSize = std::max<GLsizeiptr>(regionSize, 1);
+	this->mapping = NULL;
+	this->used = 0;
+	this->usedFrame = frame;
+	for (Range& range : dirty)
+		range = { 0, 0 };
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (GLEW_ARB_buffer_storage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, REGIONS * this->regionSize, NULL, flags);
+		mapping = (GLubyte*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, REGIONS * this->regionSize, flags);
+	}
+	else
+		glBufferData(GL_COPY_WRITE_BUFFER, REGIONS * this->regionSize, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+/*
+ * Deleting the buffer also unmaps it, draws already issued on it still complete
+ */
+inline StreamBuffer::~StreamBuffer()
+{
+	glDeleteBuffers(1, &buffer);
+}
+
+inline GLuint StreamBuffer::getBuffer()
+{
+	return buffer;
+}
+
+inline GLsizeiptr StreamBuffer::getRegionSize()
+{
+	return regionSize;
+}
+
+/*
+ * Offset of the current frame region in the buffer
+ */
+inline GLintptr StreamBuffer::getOffset()
+{
+	return (frame % REGIONS) * regionSize;
+}
+
+/*
+ * Marks [first, first + size) of the mirrored data as modified in every region
+ */
+inline void StreamBuffer::invalidate(GLintptr first, GLsizeiptr size)
+{
+	GLintptr last = std::min<GLintptr>(first + size, regionSize);
+	if (first >= last)
+		return;
+
+	for (Range& range : dirty)
+	{
+		if (range.first == range.last)
+			range = { first, last };
+		else
+			range = { std::min(range.first, first), std::max(range.last, last) };
+	}
+}
+
+/*
+ * Copies into the current region the bytes of source (regionSize long) it has not received yet
+ */
+inline void StreamBuffer::update(const void* source)
+{
+	Range& range = dirty[frame % REGIONS];
+	if (range.first == range.last)
+		return;
+
+	write(getOffset() + range.first, (const GLubyte*)source + range.first, range.last - range.first);
+	range = { 0, 0 };
+}
+
+/*
+ * Appends data to the current region, returning its offset in the buffer or -1 when the region is full
+ */
+inline GLintptr StreamBuffer::allocate(const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+	if (usedFrame != frame)
+	{
+		used = 0;
+		usedFrame = frame;
+	}
+
+	GLsizeiptr first = (used + alignment - 1) / alignment * alignment;
+	if (first + size > regionSize)
+		return -1;
+
+	used = first + size;
+	write(getOffset() + first, data, size);
+	return getOffset() + first;
+}
+
+/*
+ * Allocates from *buffer, first replacing it with one at least twice as large when the current region is full
+ * (the old buffer is only released by the driver once the draws reading it are done)
+ */
+inline GLintptr StreamBuffer::append(StreamBuffer** buffer, const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+	GLintptr offset = (*buffer)->allocate(data, size, alignment);
+	if (offset >= 0)
+		return offset;
+
+	GLsizeiptr regionSize = std::max(2 * (*buffer)->getRegionSize(), size + alignment);
+	delete *buffer;
+	*buffer = new StreamBuffer(regionSize);
+	return (*buffer)->allocate(data, size, alignment);
+}
+
+inline void StreamBuffer::write(GLintptr offset, const void* data, GLsizeiptr size)
+{
+	if (mapping != NULL)
+	{
+		memcpy(mapping + offset, data, size);
+		return;
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+inline unsigned long StreamBuffer::getFrame()
+{
+	return frame;
+}
+
+/*
+ * Waits until the GPU is done with the draws that read the current region REGIONS frames ago
+ */
+inline void StreamBuffer::beginFrame()
+{
+	GLsync& fence = fences[frame % REGIONS];
+	if (fence == NULL)
+		return;
+
+	while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(fence);
+	fence = NULL;
+}
+
+inline void StreamBuffer::endFrame()
+{
+	GLsync& fence = fences[frame % REGIONS];
+	if (fence != NULL)
+		glDeleteSync(fence);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frame++;
+}
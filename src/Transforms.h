@@ -0,0 +1,409 @@
+#pragma once
+#include "Utils.h"
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define TRANSFORMS_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORMS_SSE2
+#endif
+
+/*
+ * Batched Quaternion Utilities
+ *
+ * Euler angles (degrees) follow the Ry(angles.x) * Rz(angles.y) * Rx(angles.z) order RigidBody always used;
+ * sines and cosines of many angles are evaluated 8 (AVX2) or 4 (SSE2) at a time
+ */
+class Rotations
+{
+public:
+	static quat fromEuler(Vector angles);
+	static void fromEuler(const Vector* angles, quat* out, size_t count);
+	static Vector toEuler(quat q);
+	static quat compose(quat q, Vector delta);
+	static void slerp(const quat* from, const quat* to, float t, quat* out, size_t count);
+
+private:
+	Rotations();
+
+	static void fromHalfAngles(const float* s, const float* c, quat* out, size_t count);
+#ifdef TRANSFORMS_SSE2
+	static void sincos(__m128 x, __m128* s, __m128* c);
+#endif
+#ifdef TRANSFORMS_AVX2
+	static void sincos(__m256 x, __m256* s, __m256* c);
+#endif
+};
+
+inline quat Rotations::fromEuler(Vector angles)
+{
+	quat q;
+	fromEuler(&angles, &q, 1);
+	return q;
+}
+
+/*
+ * q = qy(angles.x) * qz(angles.y) * qx(angles.z), expanded on the half angle sines and cosines
+ */
+inline void Rotations::fromEuler(const Vector* angles, quat* out, size_t count)
+{
+	const size_t BLOCK = 64;
+	float h[3 * BLOCK], s[3 * BLOCK], c[3 * BLOCK];
+	for (size_t first = 0; first < count; first += BLOCK)
+	{
+		size_t n = std::min(BLOCK, count - first);
+		for (size_t i = 0; i < n; i++)
+		{
+			h[i] = float(radians(angles[first + i].x) / 2.0);
+			h[BLOCK + i] = float(radians(angles[first + i].y) / 2.0);
+			h[2 * BLOCK + i] = float(radians(angles[first + i].z) / 2.0);
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			size_t i = 0;
+#if defined(TRANSFORMS_AVX2)
+			for (; i + 8 <= n; i += 8)
+			{
+				__m256 vs, vc;
+				sincos(_mm256_loadu_ps(h + k * BLOCK + i), &vs, &vc);
+				_mm256_storeu_ps(s + k * BLOCK + i, vs);
+				_mm256_storeu_ps(c + k * BLOCK + i, vc);
+			}
+#endif
+#if defined(TRANSFORMS_SSE2)
+			for (; i + 4 <= n; i += 4)
+			{
+				__m128 vs, vc;
+				sincos(_mm_loadu_ps(h + k * BLOCK + i), &vs, &vc);
+				_mm_storeu_ps(s + k * BLOCK + i, vs);
+				_mm_storeu_ps(c + k * BLOCK + i, vc);
+			}
+#endif
+			for (; i < n; i++)
+			{
+				s[k * BLOCK + i] = sin(h[k * BLOCK + i]);
+				c[k * BLOCK + i] = cos(h[k * BLOCK + i]);
+			}
+		}
+
+		for (size_t i = 0; i < n; i++)
+		{
+			float sy = s[i], cy = c[i], sz = s[BLOCK + i], cz = c[BLOCK + i], sx = s[2 * BLOCK + i], cx = c[2 * BLOCK + i];
+			float w = cy * cz, x = sy * sz, y = sy * cz, z = cy * sz;
+			out[first + i] = quat(w * cx - x * sx, w * sx + x * cx, y * cx + z * sx, z * cx - y * sx);
+		}
+	}
+}
+
+inline Vector Rotations::toEuler(quat q)
+{
+	mat3 r = mat3_cast(q);
+	double sinZ = glm::clamp(double(r[0][1]), -1.0, 1.0);
+	double z = asin(sinZ), y, x;
+	if (absv(sinZ) < 0.9999)
+	{
+		y = atan2(-r[0][2], r[0][0]);
+		x = atan2(-r[2][1], r[1][1]);
+	}
+	else
+	{
+		y = atan2(r[2][0], r[2][2]);
+		x = 0.0;
+	}
+	return Vector(degrees(y), degrees(z), degrees(x));
+}
+
+/*
+ * Applies a rotation delta (degrees, same axes order) in the body's local frame
+ */
+inline quat Rotations::compose(quat q, Vector delta)
+{
+	return normalize(q * fromEuler(delta));
+}
+
+inline void Rotations::slerp(const quat* from, const quat* to, float t, quat* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		quat a = from[i], b = to[i];
+		float d = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+		float sign = d < 0.0f ? -1.0f : 1.0f;
+		d *= sign;
+
+		float wa = 1.0f - t, wb = t;
+		if (d < 0.9995f)
+		{
+			float theta = acos(d), inverse = 1.0f / sin(theta);
+			wa = sin(wa * theta) * inverse;
+			wb = sin(wb * theta) * inverse;
+		}
+		wb *= sign;
+		out[i] = normalize(quat(wa * a.w + wb * b.w, wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z));
+	}
+}
+
+#ifdef TRANSFORMS_SSE2
+/*
+ * Cody-Waite reduction to [-pi/4, pi/4] and minimax polynomials, swapped and negated by quadrant
+ */
+inline void Rotations::sincos(__m128 x, __m128* s, __m128* c)
+{
+	__m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772f)));
+	__m128 j = _mm_cvtepi32_ps(q);
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(1.5703125f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(4.837512969970703125e-4f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(7.54978995489188216e-8f)));
+	__m128 r2 = _mm_mul_ps(r, r);
+
+	__m128 ps = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(-1.9515295891e-4f)), _mm_set1_ps(8.3321608736e-3f));
+	ps = _mm_add_ps(_mm_mul_ps(r2, ps), _mm_set1_ps(-1.6666654611e-1f));
+	ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(r2, r), ps), r);
+	__m128 pc = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(2.443315711809948e-5f)), _mm_set1_ps(-1.388731625493765e-3f));
+	pc = _mm_add_ps(_mm_mul_ps(r2, pc), _mm_set1_ps(4.166664568298827e-2f));
+	pc = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(r2, r2), pc), _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, _mm_set1_ps(0.5f))));
+
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+	__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+	*s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps)), sinSign);
+	*c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc)), cosSign);
+}
+#endif
+
+#ifdef TRANSFORMS_AVX2
+inline void Rotations::sincos(__m256 x, __m256* s, __m256* c)
+{
+	__m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(0.636619772f)));
+	__m256 j = _mm256_cvtepi32_ps(q);
+	__m256 r = _mm256_fnmadd_ps(j, _mm256_set1_ps(1.5703125f), x);
+	r = _mm256_fnmadd_ps(j, _mm256_set1_ps(4.837512969970703125e-4f), r);
+	r = _mm256_fnmadd_ps(j, _mm256_set1_ps(7.54978995489188216e-8f), r);
+	__m256 r2 = _mm256_mul_ps(r, r);
+
+	__m256 ps = _mm256_fmadd_ps(r2, _mm256_set1_ps(-1.9515295891e-4f), _mm256_set1_ps(8.3321608736e-3f));
+	ps = _mm256_fmadd_ps(r2, ps, _mm256_set1_ps(-1.6666654611e-1f));
+	ps = _mm256_fmadd_ps(_mm256_mul_ps(r2, r), ps, r);
+	__m256 pc = _mm256_fmadd_ps(r2, _mm256_set1_ps(2.443315711809948e-5f), _mm256_set1_ps(-1.388731625493765e-3f));
+	pc = _mm256_fmadd_ps(r2, pc, _mm256_set1_ps(4.166664568298827e-2f));
+	pc = _mm256_fmadd_ps(_mm256_mul_ps(r2, r2), pc, _mm256_fnmadd_ps(r2, _mm256_set1_ps(0.5f), _mm256_set1_ps(1.0f)));
+
+	__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+	__m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30));
+	__m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+	*s = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, swap), sinSign);
+	*c = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, swap), cosSign);
+}
+#endif
+
+/*
+ * Batch of Body Transformations (Structure of Arrays) and the Model Matrices Computed from them
+ *
+ * Each matrix is T * S * R(orientation), written straight into one contiguous array (the instance buffer);
+ * the quaternion to matrix expansion runs on 8 (AVX2) or 4 (SSE2) bodies at a time, with a scalar fallback
+ */
+class TransformBatch
+{
+public:
+	TransformBatch();
+
+	size_t size();
+	TransformBatch* clear();
+	TransformBatch* add(Point position, Vector scale, quat orientation);
+	TransformBatch* compute();
+	mat4* getMatrices();
+	const mat4& getMatrix(size_t index);
+
+	static mat4 compute(Point position, Vector scale, quat orientation);
+
+private:
+	enum Component { PX = 0, PY, PZ, SX, SY, SZ, QX, QY, QZ, QW, COMPONENTS };
+
+	vector<float> components[COMPONENTS];
+	vector<mat4> matrices;
+
+	static void computeScalar(const float* const* in, size_t first, size_t last, float* out);
+#ifdef TRANSFORMS_SSE2
+	static void computeSSE2(const float* const* in, size_t first, size_t last, float* out);
+	static void store(__m128 c0, __m128 c1, __m128 c2, __m128 c3, float* out);
+#endif
+#ifdef TRANSFORMS_AVX2
+	static void computeAVX2(const float* const* in, size_t first, size_t last, float* out);
+#endif
+};
+
+inline TransformBatch::TransformBatch() { }
+
+inline size_t TransformBatch::size()
+{
+	return components[PX].size();
+}
+
+inline TransformBatch* TransformBatch::clear()
+{
+	for (int i = 0; i < COMPONENTS; i++)
+		components[i].clear();
+	return this;
+}
+
+inline TransformBatch* TransformBatch::add(Point position, Vector scale, quat orientation)
+{
+	components[PX].push_back(float(position.x));
+	components[PY].push_back(float(position.y));
+	components[PZ].push_back(float(position.z));
+	components[SX].push_back(float(scale.x));
+	components[SY].push_back(float(scale.y));
+	components[SZ].push_back(float(scale.z));
+	components[QX].push_back(orientation.x);
+	components[QY].push_back(orientation.y);
+	components[QZ].push_back(orientation.z);
+	components[QW].push_back(orientation.w);
+	return this;
+}
+
+inline TransformBatch* TransformBatch::compute()
+{
+	matrices.resize(size());
+	if (size() == 0)
+		return this;
+
+	const float* in[COMPONENTS];
+	for (int i = 0; i < COMPONENTS; i++)
+		in[i] = components[i].data();
+	float* out = value_ptr(matrices[0]);
+
+	size_t done = 0;
+#if defined(TRANSFORMS_AVX2)
+	done = size() - size() % 8;
+	computeAVX2(in, 0, done, out);
+#elif defined(TRANSFORMS_SSE2)
+	done = size() - size() % 4;
+	computeSSE2(in, 0, done, out);
+#endif
+	computeScalar(in, done, size(), out);
+	return this;
+}
+
+inline mat4* TransformBatch::getMatrices()
+{
+	return matrices.data();
+}
+
+inline const mat4& TransformBatch::getMatrix(size_t index)
+{
+	return matrices[index];
+}
+
+inline mat4 TransformBatch::compute(Point position, Vector scale, quat orientation)
+{
+	float values[COMPONENTS] = {
+		float(position.x), float(position.y), float(position.z),
+		float(scale.x), float(scale.y), float(scale.z),
+		orientation.x, orientation.y, orientation.z, orientation.w
+	};
+	const float* in[COMPONENTS];
+	for (int i = 0; i < COMPONENTS; i++)
+		in[i] = &values[i];
+
+	mat4 matrix;
+	computeScalar(in, 0, 1, value_ptr(matrix));
+	return matrix;
+}
+
+inline void TransformBatch::computeScalar(const float* const* in, size_t first, size_t last, float* out)
+{
+	for (size_t i = first; i < last; i++)
+	{
+		float x = in[QX][i], y = in[QY][i], z = in[QZ][i], w = in[QW][i];
+		float xx = x * x, yy = y * y, zz = z * z, xy = x * y, xz = x * z, yz = y * z, wx = w * x, wy = w * y, wz = w * z;
+		float* m = out + 16 * i;
+
+		m[0] = in[SX][i] * (1.0f - 2.0f * (yy + zz));
+		m[1] = in[SY][i] * 2.0f * (xy + wz);
+		m[2] = in[SZ][i] * 2.0f * (xz - wy);
+		m[3] = 0.0f;
+		m[4] = in[SX][i] * 2.0f * (xy - wz);
+		m[5] = in[SY][i] * (1.0f - 2.0f * (xx + zz));
+		m[6] = in[SZ][i] * 2.0f * (yz + wx);
+		m[7] = 0.0f;
+		m[8] = in[SX][i] * 2.0f * (xz + wy);
+		m[9] = in[SY][i] * 2.0f * (yz - wx);
+		m[10] = in[SZ][i] * (1.0f - 2.0f * (xx + yy));
+		m[11] = 0.0f;
+		m[12] = in[PX][i];
+		m[13] = in[PY][i];
+		m[14] = in[PZ][i];
+		m[15] = 1.0f;
+	}
+}
+
+#ifdef TRANSFORMS_SSE2
+inline void TransformBatch::computeSSE2(const float* const* in, size_t first, size_t last, float* out)
+{
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+	for (size_t i = first; i < last; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(in[QX] + i), y = _mm_loadu_ps(in[QY] + i), z = _mm_loadu_ps(in[QZ] + i), w = _mm_loadu_ps(in[QW] + i);
+		__m128 kx = _mm_mul_ps(two, _mm_loadu_ps(in[SX] + i)), ky = _mm_mul_ps(two, _mm_loadu_ps(in[SY] + i)), kz = _mm_mul_ps(two, _mm_loadu_ps(in[SZ] + i));
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+		__m128 half = _mm_set1_ps(0.5f);
+
+		float* m = out + 16 * i;
+		store(_mm_mul_ps(kx, _mm_sub_ps(half, _mm_add_ps(yy, zz))), _mm_mul_ps(ky, _mm_add_ps(xy, wz)), _mm_mul_ps(kz, _mm_sub_ps(xz, wy)), zero, m);
+		store(_mm_mul_ps(kx, _mm_sub_ps(xy, wz)), _mm_mul_ps(ky, _mm_sub_ps(half, _mm_add_ps(xx, zz))), _mm_mul_ps(kz, _mm_add_ps(yz, wx)), zero, m + 4);
+		store(_mm_mul_ps(kx, _mm_add_ps(xz, wy)), _mm_mul_ps(ky, _mm_sub_ps(yz, wx)), _mm_mul_ps(kz, _mm_sub_ps(half, _mm_add_ps(xx, yy))), zero, m + 8);
+		store(_mm_loadu_ps(in[PX] + i), _mm_loadu_ps(in[PY] + i), _mm_loadu_ps(in[PZ] + i), one, m + 12);
+	}
+}
+
+/*
+ * Transposes one matrix column of 4 bodies into their own matrices
+ */
+inline void TransformBatch::store(__m128 c0, __m128 c1, __m128 c2, __m128 c3, float* out)
+{
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	_mm_storeu_ps(out, c0);
+	_mm_storeu_ps(out + 16, c1);
+	_mm_storeu_ps(out + 32, c2);
+	_mm_storeu_ps(out + 48, c3);
+}
+#endif
+
+#ifdef TRANSFORMS_AVX2
+inline void TransformBatch::computeAVX2(const float* const* in, size_t first, size_t last, float* out)
+{
+	const __m256 two = _mm256_set1_ps(2.0f), half = _mm256_set1_ps(0.5f);
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	for (size_t i = first; i < last; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(in[QX] + i), y = _mm256_loadu_ps(in[QY] + i), z = _mm256_loadu_ps(in[QZ] + i), w = _mm256_loadu_ps(in[QW] + i);
+		__m256 kx = _mm256_mul_ps(two, _mm256_loadu_ps(in[SX] + i)), ky = _mm256_mul_ps(two, _mm256_loadu_ps(in[SY] + i)), kz = _mm256_mul_ps(two, _mm256_loadu_ps(in[SZ] + i));
+		__m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+		__m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+		__m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+		__m256 columns[3][3] = {
+			{ _mm256_mul_ps(kx, _mm256_sub_ps(half, _mm256_add_ps(yy, zz))), _mm256_mul_ps(ky, _mm256_add_ps(xy, wz)), _mm256_mul_ps(kz, _mm256_sub_ps(xz, wy)) },
+			{ _mm256_mul_ps(kx, _mm256_sub_ps(xy, wz)), _mm256_mul_ps(ky, _mm256_sub_ps(half, _mm256_add_ps(xx, zz))), _mm256_mul_ps(kz, _mm256_add_ps(yz, wx)) },
+			{ _mm256_mul_ps(kx, _mm256_add_ps(xz, wy)), _mm256_mul_ps(ky, _mm256_sub_ps(yz, wx)), _mm256_mul_ps(kz, _mm256_sub_ps(half, _mm256_add_ps(xx, yy))) }
+		};
+		for (int h = 0; h < 2; h++)
+		{
+			float* m = out + 16 * (i + 4 * h);
+			for (int j = 0; j < 3; j++)
+			{
+				__m128 c0 = h ? _mm256_extractf128_ps(columns[j][0], 1) : _mm256_castps256_ps128(columns[j][0]);
+				__m128 c1 = h ? _mm256_extractf128_ps(columns[j][1], 1) : _mm256_castps256_ps128(columns[j][1]);
+				__m128 c2 = h ? _mm256_extractf128_ps(columns[j][2], 1) : _mm256_castps256_ps128(columns[j][2]);
+				store(c0, c1, c2, zero, m + 4 * j);
+			}
+			store(_mm_loadu_ps(in[PX] + i + 4 * h), _mm_loadu_ps(in[PY] + i + 4 * h), _mm_loadu_ps(in[PZ] + i + 4 * h), one, m + 12);
+		}
+	}
+}
+#endif
\ No newline at end of file
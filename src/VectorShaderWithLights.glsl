@@ -1,35 +1,76 @@
-#version 420 core
-
-layout(location = 0) in vec3 vertexPosition;
-layout(location = 1) in vec3 vertexNormal;
-layout(location = 2) in vec4 vertexColor;
-
-uniform float time;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec3 eyePosition;
-
-uniform float shininess;
-uniform vec3 lightPosition;
-uniform vec3 ambientProduct;
-uniform vec3 diffuseProduct;
-uniform vec3 specularProduct;
-
-out vec4 Color;
-
-void main()
-{
-	vec3 M = (model * vec4(vertexPosition, 1.0)).xyz;							// trasforma le coordinate locali in coordinate nel mondo (oggetto)
-	vec3 N = normalize(model * vec4(vertexNormal, 1.0)).xyz;					// trasforma le coordinate locali in coordinate nel mondo (normali) e normalizza
-	vec3 V = normalize(eyePosition - M);										// calcola la direzione di vista normalizzata
-
-	vec3 L = normalize(lightPosition - M);										// normalizza la direzione della luce
-	vec3 R = -normalize(reflect(L, N));											// calcola la direzione di riflessione
-	vec3 ambient = ambientProduct;												// componente ambientale
-	vec3 diffuse = diffuseProduct * max(dot(L, N), 0.0);						// componenete diffusiva
-	vec3 specular = specularProduct * pow(max(dot(R, V), 0.0), shininess);		// componente speculare
-
-	gl_Position =  projection * view * model * vec4(vertexPosition, 1.0);		// trasforma le coordinate del vertice nelle coordinate di clipping
-	Color = vec4(ambient + diffuse + specular, 1.0);							// calcola il colore ottenuto e aggiunge il canale alfa
+#version 420 core
+
+// features defined by ShaderVariants: PER_PIXEL, VERTEX_COLORS, INSTANCED, LIGHTS
+#ifndef LIGHTS
+#define LIGHTS 1
+#endif
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 vertexNormal;
+#ifdef VERTEX_COLORS
+layout(location = 2) in vec4 vertexColor;
+#endif
+
+#ifdef INSTANCED
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in mat4 instanceNormalMatrix;
+#else
+layout(std140, binding = 0) uniform Instance {
+	mat4 model;
+	mat4 normalMatrix;
+};
+#endif
+
+uniform float time;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 eyePosition;
+
+uniform float shininess;
+uniform vec3 lightPosition[LIGHTS];
+uniform float lightCount;													// luci usate, non oltre LIGHTS
+uniform vec3 ambientProduct;
+uniform vec3 diffuseProduct;
+uniform vec3 specularProduct;
+
+invariant gl_Position;														// identica alla depth pre-pass, per il test GL_EQUAL
+
+#ifdef PER_PIXEL
+out vec3 Position;
+out vec3 Normal;
+#endif
+out vec4 Color;
+
+void main()
+{
+#ifdef INSTANCED
+	mat4 model = instanceModel;
+	mat4 normalMatrix = instanceNormalMatrix;
+#endif
+#ifdef VERTEX_COLORS
+	vec4 base = vertexColor;
+#else
+	vec4 base = vec4(1.0);
+#endif
+
+	vec3 M = (model * vec4(vertexPosition, 1.0)).xyz;							// trasforma le coordinate locali in coordinate nel mondo (oggetto)
+	vec3 N = normalize(mat3(normalMatrix) * vertexNormal);								// trasforma le normali con l'inversa trasposta del modello e normalizza
+	gl_Position =  projection * view * model * vec4(vertexPosition, 1.0);		// trasforma le coordinate del vertice nelle coordinate di clipping
+
+#ifdef PER_PIXEL
+	Position = M;																// l'illuminazione viene calcolata nel fragment shader
+	Normal = N;
+	Color = base;
+#else
+	vec3 V = normalize(eyePosition - M);										// calcola la direzione di vista normalizzata
+	vec3 light = ambientProduct;												// componente ambientale
+	for (int i = 0; i < min(int(lightCount), LIGHTS); i++)
+	{
+		vec3 L = normalize(lightPosition[i] - M);								// normalizza la direzione della luce
+		vec3 R = -normalize(reflect(L, N));										// calcola la direzione di riflessione
+		light += diffuseProduct * max(dot(L, N), 0.0);							// componenete diffusiva
+		light += specularProduct * pow(max(dot(R, V), 0.0), shininess);			// componente speculare
+	}
+	Color = vec4(base.rgb * light, base.a);										// calcola il colore ottenuto e aggiunge il canale alfa
+#endif
 }
\ No newline at end of file